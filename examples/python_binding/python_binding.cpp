@@ -33,6 +33,54 @@ class Camera
     }
 
     void SendFrame(py::array_t<uint8_t, py::array::c_style | py::array::forcecast> image)
+    {
+        CheckImage(image);
+
+        py::gil_scoped_release release;
+        scSendFrame(m_camera, image.data(0, 0));
+    }
+
+    void SendFrameAsync(py::array_t<uint8_t, py::array::c_style | py::array::forcecast> image)
+    {
+        CheckImage(image);
+
+        py::gil_scoped_release release;
+        scSendFrameAsync(m_camera, image.data(0, 0));
+    }
+
+    int FrameQueueDepth()
+    {
+        if (!m_camera)
+        {
+            throw std::runtime_error("the camera instance has been deleted");
+        }
+
+        return scGetFrameQueueDepth(m_camera);
+    }
+
+    bool WaitForConnection(float timeout = 0.0f)
+    {
+        if (!m_camera)
+        {
+            throw std::runtime_error("the camera instance has been deleted");
+        }
+
+        py::gil_scoped_release release;
+        return scWaitForConnection(m_camera, timeout);
+    }
+
+    bool IsConnected()
+    {
+        if (!m_camera)
+        {
+            throw std::runtime_error("the camera instance has been deleted");
+        }
+
+        return scIsConnected(m_camera);
+    }
+
+ private:
+    void CheckImage(py::array_t<uint8_t, py::array::c_style | py::array::forcecast>& image)
     {
         if (!m_camera)
         {
@@ -63,33 +111,8 @@ class Camera
                 "actual=" + std::to_string(info.shape[1]) + "x" + std::to_string(info.shape[0])
             );
         }
-
-        py::gil_scoped_release release;
-        scSendFrame(m_camera, image.data(0, 0));
     }
 
-    bool WaitForConnection(float timeout = 0.0f)
-    {
-        if (!m_camera)
-        {
-            throw std::runtime_error("the camera instance has been deleted");
-        }
-
-        py::gil_scoped_release release;
-        return scWaitForConnection(m_camera, timeout);
-    }
-
-    bool IsConnected()
-    {
-        if (!m_camera)
-        {
-            throw std::runtime_error("the camera instance has been deleted");
-        }
-
-        return scIsConnected(m_camera);
-    }
-
- private:
     scCamera    m_camera{};
     int         m_width = 0;
     int         m_height = 0;
@@ -115,6 +138,15 @@ PYBIND11_MODULE(softcam, m) {
             &Camera::SendFrame,
             py::arg("image")
         )
+        .def(
+            "send_frame_async",
+            &Camera::SendFrameAsync,
+            py::arg("image")
+        )
+        .def(
+            "frame_queue_depth",
+            &Camera::FrameQueueDepth
+        )
         .def(
             "wait_for_connection",
             &Camera::WaitForConnection,
@@ -104,6 +104,34 @@ def test_send_frame_use_after_free():
     assert e.value.args == ('the camera instance has been deleted',)
 
 
+def test_send_frame_async_normalcase():
+    cam = softcam.camera(320, 240, 60)
+    for i in range(3):
+        cam.send_frame_async(np.zeros((240, 320, 3), dtype=np.uint8))
+    assert 0 <= cam.frame_queue_depth() <= 3
+    cam.delete()
+
+
+def test_send_frame_async_invalid_dimension():
+    cam = softcam.camera(320, 240, 60)
+    with pytest.raises(ValueError):
+        cam.send_frame_async(np.zeros((240, 320), dtype=np.uint8))
+    with pytest.raises(ValueError):
+        cam.send_frame_async(np.zeros((320, 320, 3), dtype=np.uint8))
+    cam.delete()
+
+
+def test_send_frame_async_use_after_free():
+    cam = softcam.camera(320, 240, 60)
+    cam.delete()
+    with pytest.raises(RuntimeError) as e:
+        cam.send_frame_async(np.zeros((240, 320, 3), dtype=np.uint8))
+    assert e.value.args == ('the camera instance has been deleted',)
+    with pytest.raises(RuntimeError) as e:
+        cam.frame_queue_depth()
+    assert e.value.args == ('the camera instance has been deleted',)
+
+
 def test_wait_for_connection():
     cam = softcam.camera(320, 240, 60)
     assert cam.wait_for_connection(0.01) == False
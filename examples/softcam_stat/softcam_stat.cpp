@@ -0,0 +1,294 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <softcamcore/FrameBuffer.h>
+#include <softcamcore/Misc.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+
+namespace sc = softcam;
+
+
+// softcam_stat - a top-like monitor of a Softcam camera
+//
+// This attaches to the shared memory of a camera read-only and shows what
+// the sender and the receivers are doing. It doesn't connect to the camera
+// as a receiver, so the sender sees no difference whether it is running.
+//
+//   usage: softcam_stat [-n NAME] [-i SECONDS] [-c COUNT]
+
+
+struct Options
+{
+    const char* name = nullptr;     // the default camera
+    float       interval = 1.0f;
+    int         count = 0;          // forever
+};
+
+
+/// Heartbeat Tracking
+///
+/// A peer is regarded as alive while its heartbeat keeps changing within
+/// the watchdog timeout, just like the watchdogs of Softcam do.
+class Heartbeat
+{
+ public:
+    void    update(uint32_t heartbeat, uint64_t now)
+    {
+        if (m_time == 0 || heartbeat != m_heartbeat)
+        {
+            m_heartbeat = heartbeat;
+            m_time = now;
+        }
+        m_now = now;
+    }
+    bool    alive() const
+    {
+        return (float)(m_now - m_time) * 1e-9f < sc::FrameBuffer::WATCHDOG_TIMEOUT;
+    }
+
+ private:
+    uint32_t    m_heartbeat = 0;
+    uint64_t    m_time = 0;
+    uint64_t    m_now = 0;
+};
+
+
+/// The Screen of softcam_stat
+class Monitor
+{
+ public:
+    explicit Monitor(const Options& options) : m_options(options) {}
+
+    bool    update(const sc::FrameBuffer& fb, uint64_t now);
+    void    reset() { m_has_last = false; }
+
+ private:
+    Options             m_options;
+    sc::FrameBuffer::Stats  m_last = {};
+    bool                m_has_last = false;
+    uint64_t            m_last_time = 0;
+    Heartbeat           m_sender_heartbeat;
+    Heartbeat           m_receiver_heartbeat;
+    Heartbeat           m_receiver_heartbeats[sc::FrameBuffer::NUM_RECEIVER_SLOTS];
+
+    static const char*  percentile(const uint32_t* histogram, uint64_t total, double p);
+};
+
+
+// Returns the upper bound of the latency bucket containing the percentile.
+const char* Monitor::percentile(const uint32_t* histogram, uint64_t total, double p)
+{
+    static const char* const labels[sc::FrameBuffer::NUM_LATENCY_BUCKETS] = {
+        "<1us", "<2us", "<4us", "<8us", "<16us", "<32us", "<64us", "<128us",
+        "<256us", "<512us", "<1ms", "<2ms", "<4ms", "<8ms", "<16ms", "<33ms",
+        "<66ms", "<131ms", "<262ms", ">262ms"
+    };
+    if (total == 0)
+    {
+        return "-";
+    }
+    uint64_t rank = (uint64_t)(p * (double)total + 0.5);
+    uint64_t sum = 0;
+    for (int i = 0; i < sc::FrameBuffer::NUM_LATENCY_BUCKETS; i++)
+    {
+        sum += histogram[i];
+        if (rank <= sum)
+        {
+            return labels[i];
+        }
+    }
+    return labels[sc::FrameBuffer::NUM_LATENCY_BUCKETS - 1];
+}
+
+bool Monitor::update(const sc::FrameBuffer& fb, uint64_t now)
+{
+    sc::FrameBuffer::Stats stats;
+    if (!fb.stats(&stats))
+    {
+        return false;
+    }
+    const double elapsed = m_has_last ? (double)(now - m_last_time) * 1e-9 : 0.0;
+    const sc::FrameBuffer::Stats& last = m_has_last ? m_last : stats;
+    auto rate = [elapsed](uint64_t current, uint64_t previous)
+    {
+        return 0.0 < elapsed ? (double)(current - previous) / elapsed : 0.0;
+    };
+    auto average = [](uint64_t sum, uint64_t count)
+    {
+        return 0 < count ? (double)sum / (double)count * 1e-3 : 0.0;
+    };
+
+    m_sender_heartbeat.update(stats.m_sender_heartbeat, now);
+    m_receiver_heartbeat.update(stats.m_receiver_heartbeat, now);
+    const bool sender_running = sc::Process::isAlive(
+                        stats.m_sender_process_id, stats.m_sender_start_time);
+    const char* sender_state = !sender_running ? "dead" :
+                        !fb.active() ? "inactive" :
+                        m_sender_heartbeat.alive() ? "alive" : "stalled";
+
+    // Clear the screen and move the cursor home.
+    std::printf("\x1b[H\x1b[2J");
+    std::printf("softcam_stat - %s  %dx%d  %.1f fps configured  (every %.1fs)\n\n",
+                m_options.name ? m_options.name : "(default camera)",
+                fb.width(), fb.height(), fb.framerate(), m_options.interval);
+    std::printf("Sender    pid %u  watchdog %s  frames %llu  fps %.1f  unchanged %llu\n",
+                stats.m_sender_process_id, sender_state,
+                (unsigned long long)stats.m_frames_written,
+                rate(stats.m_frames_written, last.m_frames_written),
+                (unsigned long long)stats.m_unchanged_frames);
+
+    uint64_t paced = stats.m_paced_frames - last.m_paced_frames;
+    std::printf("Pacing    paced %llu  late %llu  oversleep avg %.1fus max %.1fus  undersleep avg %.1fus\n",
+                (unsigned long long)stats.m_paced_frames,
+                (unsigned long long)stats.m_late_frames,
+                average(stats.m_oversleep - last.m_oversleep, paced),
+                (double)stats.m_max_oversleep * 1e-3,
+                average(stats.m_undersleep - last.m_undersleep, paced));
+    std::printf("Jitter    p50 %.1fus  p99 %.1fus\n",
+                (double)stats.m_jitter_p50 * 1e-3,
+                (double)stats.m_jitter_p99 * 1e-3);
+    std::printf("Mutex     waits %llu  wait avg %.1fus max %.1fus\n",
+                (unsigned long long)stats.m_mutex_waits,
+                average(stats.m_mutex_wait_time - last.m_mutex_wait_time,
+                        stats.m_mutex_waits - last.m_mutex_waits),
+                (double)stats.m_max_mutex_wait_time * 1e-3);
+    std::printf("Legacy receivers' watchdog %s\n\n",
+                m_receiver_heartbeat.alive() ? "alive" : "idle");
+
+    std::printf("%4s %8s %8s %10s %8s %6s %8s %8s %8s %8s\n",
+                "SLOT", "PID", "WATCHDOG", "READ", "SKIPPED", "LAG",
+                "FPS", "P50", "P90", "P99");
+    for (int i = 0; i < sc::FrameBuffer::NUM_RECEIVER_SLOTS; i++)
+    {
+        auto& r = stats.m_receivers[i];
+        auto& l = last.m_receivers[i];
+        if (!r.m_in_use)
+        {
+            m_receiver_heartbeats[i] = Heartbeat{};
+            continue;
+        }
+        // The histogram of the interval shows the recent latencies, unless
+        // the slot has changed hands in the meantime.
+        const bool same = l.m_in_use && l.m_process_id == r.m_process_id &&
+                          l.m_start_time == r.m_start_time &&
+                          l.m_frames_read <= r.m_frames_read;
+        uint32_t histogram[sc::FrameBuffer::NUM_LATENCY_BUCKETS];
+        uint64_t total = 0;
+        for (int j = 0; j < sc::FrameBuffer::NUM_LATENCY_BUCKETS; j++)
+        {
+            histogram[j] = r.m_latency_histogram[j] - (same ? l.m_latency_histogram[j] : 0);
+            total += histogram[j];
+        }
+        m_receiver_heartbeats[i].update(r.m_heartbeat, now);
+        const bool running = sc::Process::isAlive(r.m_process_id, r.m_start_time);
+        uint64_t lag = r.m_frame_counter < stats.m_frames_written ?
+                        stats.m_frames_written - r.m_frame_counter : 0;
+        std::printf("%4d %8u %8s %10llu %8llu %6llu %8.1f %8s %8s %8s\n",
+                    i, r.m_process_id,
+                    !running ? "dead" :
+                    m_receiver_heartbeats[i].alive() ? "alive" : "stalled",
+                    (unsigned long long)r.m_frames_read,
+                    (unsigned long long)r.m_frames_skipped,
+                    (unsigned long long)lag,
+                    same ? rate(r.m_frames_read, l.m_frames_read) : 0.0,
+                    percentile(histogram, total, 0.50),
+                    percentile(histogram, total, 0.90),
+                    percentile(histogram, total, 0.99));
+    }
+    std::fflush(stdout);
+
+    m_last = stats;
+    m_last_time = now;
+    m_has_last = true;
+    return sender_running && fb.active();
+}
+
+
+static bool parseOptions(int argc, char* argv[], Options* options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(arg, "-n") == 0 && value)
+        {
+            options->name = value;
+        }
+        else if (std::strcmp(arg, "-i") == 0 && value)
+        {
+            options->interval = (float)std::atof(value);
+            if (options->interval <= 0.0f)
+            {
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "-c") == 0 && value)
+        {
+            options->count = std::atoi(value);
+        }
+        else
+        {
+            return false;
+        }
+        i += 1;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, &options))
+    {
+        std::printf("usage: softcam_stat [-n NAME] [-i SECONDS] [-c COUNT]\n");
+        std::printf("  -n NAME     the name of the camera instance (default: the default camera)\n");
+        std::printf("  -i SECONDS  the refresh interval (default: 1)\n");
+        std::printf("  -c COUNT    the number of refreshes before exiting (default: forever)\n");
+        return 1;
+    }
+#ifdef _WIN32
+    // Let the console interpret the escape sequences which clear the screen.
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(console, &mode))
+    {
+        SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+#endif
+
+    Monitor monitor(options);
+    sc::FrameBuffer fb = sc::FrameBuffer::observe(options.name);
+    for (int i = 0; options.count <= 0 || i < options.count; i++)
+    {
+        if (i != 0)
+        {
+            sc::Timer::sleep(options.interval);
+        }
+        if (!fb)
+        {
+            fb = sc::FrameBuffer::observe(options.name);
+        }
+        if (!fb || !monitor.update(fb, sc::Timer::now()))
+        {
+            // Let go of the shared memory so that a new sender can create
+            // the camera again, and look for it at the next refresh.
+            if (fb)
+            {
+                fb.release();
+                monitor.reset();
+                std::printf("\nThe camera has been closed.\n");
+            }
+            else
+            {
+                std::printf("\x1b[H\x1b[2J");
+                std::printf("softcam_stat - waiting for the camera (it may be of an older version)\n");
+            }
+            std::fflush(stdout);
+        }
+    }
+    return 0;
+}
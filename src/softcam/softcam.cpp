@@ -2,6 +2,8 @@
 
 #include <olectl.h>
 #include <initguid.h>
+#include <cstddef>
+#include <cstring>
 
 #include <softcamcore/DShowSoftcam.h>
 #include <softcamcore/SenderAPI.h>
@@ -162,6 +164,22 @@ extern "C" scCamera scCreateCamera(int width, int height, float framerate)
     return softcam::sender::CreateCamera(width, height, framerate);
 }
 
+extern "C" scCamera scCreateCameraNamed(const char* name, int width, int height, float framerate)
+{
+    return softcam::sender::CreateCameraNamed(name, width, height, framerate);
+}
+
+extern "C" scCamera scCreateCameraEx(const char* name, int width, int height, float framerate, unsigned flags)
+{
+    static_assert(SC_CAMERA_BOTTOM_UP == softcam::sender::CAMERA_FLAG_BOTTOM_UP, "");
+    static_assert(SC_CAMERA_PACING_DROP == softcam::sender::CAMERA_FLAG_PACING_DROP, "");
+    static_assert(SC_CAMERA_PACING_BURST == softcam::sender::CAMERA_FLAG_PACING_BURST, "");
+    static_assert(SC_CAMERA_PACING_REANCHOR == softcam::sender::CAMERA_FLAG_PACING_REANCHOR, "");
+    static_assert(SC_CAMERA_ASYNC_BLOCK == softcam::sender::CAMERA_FLAG_ASYNC_BLOCK, "");
+    static_assert(SC_CAMERA_SKIP_UNCHANGED == softcam::sender::CAMERA_FLAG_SKIP_UNCHANGED, "");
+    return softcam::sender::CreateCameraEx(name, width, height, framerate, flags);
+}
+
 extern "C" void     scDeleteCamera(scCamera camera)
 {
     return softcam::sender::DeleteCamera(camera);
@@ -172,6 +190,48 @@ extern "C" void     scSendFrame(scCamera camera, const void* image_bits)
     return softcam::sender::SendFrame(camera, image_bits);
 }
 
+extern "C" void     scSendFrameWithTimestamp(scCamera camera, const void* image_bits, uint64_t timestamp)
+{
+    return softcam::sender::SendFrameWithTimestamp(camera, image_bits, timestamp);
+}
+
+extern "C" bool     scSendFrameEx(scCamera camera, const void* image_bits, int stride, unsigned flags)
+{
+    return softcam::sender::SendFrameEx(camera, image_bits, stride, flags);
+}
+
+extern "C" bool     scSendFrameRegions(scCamera camera, const void* image_bits, const scRect* rects, int count)
+{
+    static_assert(sizeof(scRect) == sizeof(softcam::sender::Rect) &&
+                  offsetof(scRect, x) == offsetof(softcam::sender::Rect, x) &&
+                  offsetof(scRect, y) == offsetof(softcam::sender::Rect, y) &&
+                  offsetof(scRect, width) == offsetof(softcam::sender::Rect, width) &&
+                  offsetof(scRect, height) == offsetof(softcam::sender::Rect, height),
+                  "scRect should be the same as softcam::sender::Rect");
+    return softcam::sender::SendFrameRegions(
+                camera, image_bits, reinterpret_cast<const softcam::sender::Rect*>(rects), count);
+}
+
+extern "C" void     scSendFrameAsync(scCamera camera, const void* image_bits)
+{
+    return softcam::sender::SendFrameAsync(camera, image_bits);
+}
+
+extern "C" int      scGetFrameQueueDepth(scCamera camera)
+{
+    return softcam::sender::GetFrameQueueDepth(camera);
+}
+
+extern "C" bool     scAcquireFrameBuffer(scCamera camera, void** out_image_bits, int* out_stride)
+{
+    return softcam::sender::AcquireFrameBuffer(camera, out_image_bits, out_stride);
+}
+
+extern "C" void     scCommitFrame(scCamera camera)
+{
+    return softcam::sender::CommitFrame(camera);
+}
+
 extern "C" bool     scWaitForConnection(scCamera camera, float timeout)
 {
     return softcam::sender::WaitForConnection(camera, timeout);
@@ -181,3 +241,43 @@ extern "C" bool     scIsConnected(scCamera camera)
 {
     return softcam::sender::IsConnected(camera);
 }
+
+extern "C" bool     scGetCameraStats(scCamera camera, scCameraStats* out_stats)
+{
+    softcam::sender::CameraStats stats;
+    if (!out_stats || out_stats->size <= offsetof(scCameraStats, frames_written) ||
+        !softcam::sender::GetCameraStats(camera, &stats))
+    {
+        return false;
+    }
+    // The structure given by the caller may be older and smaller than ours,
+    // or newer and larger.
+    const std::size_t size = out_stats->size;
+    scCameraStats result = {};
+    result.size = out_stats->size;
+    result.frames_written = stats.frames_written;
+    result.frames_read = stats.frames_read;
+    result.frames_skipped = stats.frames_skipped;
+    result.receivers = stats.receivers;
+    result.paced_frames = stats.paced_frames;
+    result.late_frames = stats.late_frames;
+    result.oversleep_ns = stats.oversleep_ns;
+    result.max_oversleep_ns = stats.max_oversleep_ns;
+    result.undersleep_ns = stats.undersleep_ns;
+    result.mutex_waits = stats.mutex_waits;
+    result.mutex_wait_ns = stats.mutex_wait_ns;
+    result.max_mutex_wait_ns = stats.max_mutex_wait_ns;
+    result.unchanged_frames = stats.unchanged_frames;
+    result.jitter_p50_ns = stats.jitter_p50_ns;
+    result.jitter_p99_ns = stats.jitter_p99_ns;
+    if (size <= sizeof(result))
+    {
+        std::memcpy(out_stats, &result, size);
+    }
+    else
+    {
+        std::memcpy(out_stats, &result, sizeof(result));
+        std::memset(reinterpret_cast<char*>(out_stats) + sizeof(result), 0, size - sizeof(result));
+    }
+    return true;
+}
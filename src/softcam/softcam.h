@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 
 //
 // Softcam Sender API
@@ -42,6 +44,90 @@ extern "C"
     */
     scCamera    SOFTCAM_API scCreateCamera(int width, int height, float framerate = 60.0f);
 
+    /*
+        This function creates a named virtual camera instance.
+
+        Unlike the `scCreateCamera` function, which creates the default
+        instance, this function lets a process or several processes run
+        multiple virtual cameras at the same time, as long as each of them
+        has a distinct name. The name should be 1 to 63 characters long and
+        should not contain slashes or backslashes. If the `name` argument is
+        a null pointer, this function creates the default instance.
+
+        Named instances are listed in a directory shared on the system, by
+        which receivers can find them and attach to a specific one.
+        Note that the DirectShow filter of this library attaches to the
+        default instance only.
+
+        The other arguments and the return value are the same as the
+        `scCreateCamera` function. This function fails if another instance
+        with the same name already exists in the system.
+    */
+    scCamera    SOFTCAM_API scCreateCameraNamed(const char* name, int width, int height, float framerate = 60.0f);
+
+    /*
+        Flags for the `scCreateCameraEx` function.
+
+        SC_CAMERA_BOTTOM_UP:
+            The sender stores each frame in the shared memory bottom-up,
+            which is the row order of DIBs used by DirectShow. The image is
+            flipped once by the sender instead of once by each receiver,
+            and receivers deliver it with a single copy.
+            The `scAcquireFrameBuffer` function then returns the address of
+            the top row and a negative stride.
+            Note that receivers of older versions of this library show the
+            image upside down.
+
+        SC_CAMERA_PACING_DROP, SC_CAMERA_PACING_BURST, SC_CAMERA_PACING_REANCHOR:
+            One of these selects how the `scSendFrame` function paces frames
+            after a frame which came later than its scheduled time. The late
+            frame itself is always sent immediately.
+            With SC_CAMERA_PACING_DROP, the missed times are skipped and the
+            following frames are sent at the original schedule.
+            With SC_CAMERA_PACING_BURST, the following frames are sent
+            without sleeping until they catch up with the original schedule.
+            With SC_CAMERA_PACING_REANCHOR, the schedule starts over from the
+            late frame.
+            If none of them is specified, the following frames catch up if
+            the delay is less than half the frame period, and the schedule
+            starts over otherwise.
+
+        SC_CAMERA_ASYNC_BLOCK:
+            The `scSendFrameAsync` function waits for room in the queue
+            when the queue is full, instead of discarding the oldest queued
+            frame.
+
+        SC_CAMERA_SKIP_UNCHANGED:
+            The `scSendFrame`, `scSendFrameWithTimestamp` and `scSendFrameEx`
+            functions compute a fast hash of each image and don't write the
+            frame if the image is the same as the previous frame, which saves
+            the copy by the sender and by every receiver. The function still
+            waits for the time of the frame as if it were sent, and the frame
+            is counted in the `unchanged_frames` member of `scCameraStats`.
+            Note that receivers see no new frame while the image stays the
+            same; the DirectShow filter of this library repeats the last
+            image at least every 0.5 seconds in that case.
+    */
+    enum scCameraFlags : unsigned
+    {
+        SC_CAMERA_BOTTOM_UP         = 0x0001,
+        SC_CAMERA_PACING_DROP       = 0x0010,
+        SC_CAMERA_PACING_BURST      = 0x0020,
+        SC_CAMERA_PACING_REANCHOR   = 0x0030,
+        SC_CAMERA_ASYNC_BLOCK       = 0x0100,
+        SC_CAMERA_SKIP_UNCHANGED    = 0x0200,
+    };
+
+    /*
+        This function creates a virtual camera instance with options.
+
+        The `flags` argument is a combination of the `scCameraFlags` values.
+        The other arguments and the return value are the same as the
+        `scCreateCameraNamed` function. This function fails if the `flags`
+        argument contains unknown bits.
+    */
+    scCamera    SOFTCAM_API scCreateCameraEx(const char* name, int width, int height, float framerate, unsigned flags);
+
     /*
         This function deletes the specified virtual camera instance.
     */
@@ -62,6 +148,157 @@ extern "C"
     */
     void        SOFTCAM_API scSendFrame(scCamera camera, const void* image_bits);
 
+    /*
+        This function sends a new frame of the specified virtual camera
+        along with the time the frame was captured.
+
+        The `timestamp` argument is the capture time in nanoseconds on any
+        clock of the application's choice, which should be the same clock
+        for all frames of the camera. Receivers use the differences between
+        the timestamps of frames to time them, instead of the times the
+        frames arrive, so that the timing set by the application, such as
+        that of a source with a variable framerate, is kept downstream.
+        The frames sent by the other functions are stamped with the time
+        they are sent.
+
+        The timing of the delivery is controlled in the same way as the
+        `scSendFrame` function does.
+    */
+    void        SOFTCAM_API scSendFrameWithTimestamp(scCamera camera, const void* image_bits, uint64_t timestamp);
+
+    /*
+        This function sends a new frame of the specified virtual camera
+        from an image whose rows are not tightly packed, such as an image
+        with padding at the end of each row or a part of a larger image.
+
+        The `image_bits` argument is the address of the first row of the
+        image in memory, and the `stride` argument is the distance in bytes
+        between the starts of adjacent rows, which must be at least three
+        times the width of the camera. A negative stride means that the
+        image is stored bottom-up; the first row in memory is then the
+        bottom row of the image, and each row is placed `-stride` bytes
+        before the row below it. Each row is copied directly into the
+        shared memory, so the application doesn't need to pack the image
+        into another buffer beforehand.
+
+        The `flags` argument is reserved for future use and must be 0.
+
+        The timing of the delivery is controlled in the same way as the
+        `scSendFrame` function does.
+
+        This function returns `true` if the frame is sent. It returns
+        `false` if any argument is invalid.
+    */
+    bool        SOFTCAM_API scSendFrameEx(scCamera camera, const void* image_bits, int stride, unsigned flags);
+
+    /*
+        A rectangle in an image for the `scSendFrameRegions` function.
+        The `x` and `y` members are the position of the top-left corner in
+        pixels from the top-left corner of the image.
+    */
+    struct scRect
+    {
+        int         x;
+        int         y;
+        int         width;
+        int         height;
+    };
+
+    /*
+        This function sends a new frame of the specified virtual camera
+        in which only the given rectangles have changed from the previous
+        frame, such as a frame of a screen capture.
+
+        The `image_bits` argument is the entire new image in the same format
+        as the `scSendFrame` function takes, but only the pixels inside the
+        `count` rectangles given by the `rects` argument are read from it and
+        copied into the shared memory. The rest of the image stays the same
+        as the previous frame. Rectangles may overlap each other, and the
+        parts of them outside the image are ignored. If `count` is 0,
+        the previous image is sent again as a new frame.
+
+        Receivers which keep the image of the previous frame can copy only
+        the tiles of 64x64 pixels containing the changes, which are recorded
+        in the shared memory for each frame.
+
+        The timing of the delivery is controlled in the same way as the
+        `scSendFrame` function does.
+
+        This function returns `true` if the frame is sent. It returns
+        `false` if any argument is invalid.
+    */
+    bool        SOFTCAM_API scSendFrameRegions(scCamera camera, const void* image_bits, const scRect* rects, int count);
+
+    /*
+        This function sends a new frame of the specified virtual camera
+        without waiting for the time to deliver it.
+
+        The image is copied into a queue of up to three frames and this
+        function returns immediately. A thread owned by this library takes
+        the frames out of the queue in order and delivers each of them at
+        the time the `scSendFrame` function would deliver it.
+
+        If the queue is full, the oldest queued frame is discarded to make
+        room for the new one, unless the camera was created with the
+        `SC_CAMERA_ASYNC_BLOCK` flag, in which case this function waits
+        until a queued frame is delivered.
+
+        The `scSendFrame` function, the `scAcquireFrameBuffer` function
+        and the `scDeleteCamera` function can be mixed with this function.
+        The first two wait until all the queued frames are delivered, and
+        the last discards them.
+    */
+    void        SOFTCAM_API scSendFrameAsync(scCamera camera, const void* image_bits);
+
+    /*
+        This function returns the number of frames which have been sent by
+        the `scSendFrameAsync` function but not delivered yet, including the
+        frame being delivered.
+    */
+    int         SOFTCAM_API scGetFrameQueueDepth(scCamera camera);
+
+    /*
+        This function gives direct access to the image buffer of the next
+        frame of the specified virtual camera, which is inside the shared
+        memory.
+
+        By rendering the image directly into this buffer and then calling
+        the `scCommitFrame` function, the application can send a frame
+        without the extra copy that the `scSendFrame` function makes.
+
+        The buffer has the same format as the `image_bits` argument of the
+        `scSendFrame` function, except that each row starts at the offset
+        of a multiple of the value stored in `*out_stride` in bytes.
+        The stride is negative if the camera was created with the
+        `SC_CAMERA_BOTTOM_UP` flag.
+        The initial content of the buffer is undefined, so the application
+        should write the entire image every time.
+
+        If this function succeeds, it returns `true` and stores the address
+        of the buffer to `*out_image_bits`. Otherwise, it returns `false`.
+
+        The buffer is valid until the `scCommitFrame` function, the
+        `scDeleteCamera` function or any of the functions sending a frame,
+        which are the `scSendFrame`, `scSendFrameWithTimestamp`,
+        `scSendFrameEx`, `scSendFrameRegions` and `scSendFrameAsync`
+        functions, is called. In particular, the image given to the
+        `scSendFrameAsync` function may be copied into the same memory at
+        any time after the call, so the application must not write to
+        the buffer once it has called that function.
+    */
+    bool        SOFTCAM_API scAcquireFrameBuffer(scCamera camera, void** out_image_bits, int* out_stride);
+
+    /*
+        This function sends the frame which has been written into the buffer
+        obtained by the `scAcquireFrameBuffer` function.
+
+        The timing of the delivery is controlled in the same way as the
+        `scSendFrame` function does.
+
+        This function does nothing if the buffer has not been acquired.
+    */
+    void        SOFTCAM_API scCommitFrame(scCamera camera);
+
     /*
         This function waits until an application connects to the specified
         virtual camera.
@@ -82,4 +319,76 @@ extern "C"
         the virtual camera. Otherwise, it returns `false`.
     */
     bool        SOFTCAM_API scIsConnected(scCamera camera);
+
+    /*
+        Statistics of a virtual camera, filled by the `scGetCameraStats`
+        function. Times are in nanoseconds.
+
+        size:
+            The size of this structure in bytes, which the caller should
+            set to `sizeof(scCameraStats)` before calling the function.
+            Members may be added to the end of this structure in future
+            versions, and the size tells which of them the caller knows.
+        frames_written:
+            The number of frames sent.
+        frames_read, frames_skipped, receivers:
+            The numbers of frames read and of frames skipped, which were
+            overwritten before being read, summed over the receivers
+            currently connected, and the number of those receivers.
+            Receivers of older versions of this library are not counted.
+        paced_frames, oversleep_ns, max_oversleep_ns, undersleep_ns:
+            The number of frames for which the sender slept to keep the
+            framerate, and the total and the maximum of the time it woke up
+            after the scheduled time, and the total of the time it woke up
+            before that.
+        late_frames:
+            The number of frames given after their scheduled time.
+        mutex_waits, mutex_wait_ns, max_mutex_wait_ns:
+            The number of times the sender took the lock shared with the
+            receivers, and the total and the maximum time it waited for it.
+        unchanged_frames:
+            The number of frames not written since they were the same as
+            the previous frame. See `SC_CAMERA_SKIP_UNCHANGED`.
+        jitter_p50_ns, jitter_p99_ns:
+            The 50th and 99th percentiles of the difference between the
+            scheduled time and the time each of the last 1024 frames was
+            delivered, updated every 16 frames. They are 0 until the second
+            frame or if the framerate is 0.
+    */
+    struct scCameraStats
+    {
+        uint32_t    size;
+        uint64_t    frames_written;
+        uint64_t    frames_read;
+        uint64_t    frames_skipped;
+        uint32_t    receivers;
+        uint64_t    paced_frames;
+        uint64_t    late_frames;
+        uint64_t    oversleep_ns;
+        uint64_t    max_oversleep_ns;
+        uint64_t    undersleep_ns;
+        uint64_t    mutex_waits;
+        uint64_t    mutex_wait_ns;
+        uint64_t    max_mutex_wait_ns;
+        uint64_t    unchanged_frames;
+        uint64_t    jitter_p50_ns;
+        uint64_t    jitter_p99_ns;
+    };
+
+    /*
+        This function takes a snapshot of the statistics of the specified
+        virtual camera, which are kept in the shared memory and updated as
+        frames are sent and received.
+
+        The `size` member of `*out_stats` should be set by the caller.
+        This function writes only the first `size` bytes of the structure,
+        so that an application built with an older version of this header
+        keeps working, and sets the members which this version of the
+        library doesn't know to zero.
+
+        If this function succeeds, it returns `true` and stores the
+        statistics to `*out_stats`. It returns `false` if `size` is too
+        small to hold any statistics.
+    */
+    bool        SOFTCAM_API scGetCameraStats(scCamera camera, scCameraStats* out_stats);
 }
@@ -0,0 +1,228 @@
+#include "CopyEngine.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SOFTCAM_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SOFTCAM_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX  __attribute__((target("avx")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX
+#endif
+
+
+namespace softcam {
+
+
+namespace {
+
+#if defined(SOFTCAM_X86)
+
+bool detectSSE2()
+{
+    #if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+    #else
+    return __builtin_cpu_supports("sse2");
+    #endif
+}
+
+bool detectAVX()
+{
+    #if defined(_MSC_VER)
+    // The OS must also save the YMM registers on context switches.
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    return osxsave && avx && (_xgetbv(0) & 6) == 6;
+    #else
+    return __builtin_cpu_supports("avx");
+    #endif
+}
+
+// The non-temporal stores require aligned destination addresses, so the
+// unaligned head and the remainder at the tail are copied with memcpy.
+// The caller must issue an sfence after the streaming stores, which orders
+// them before any subsequent store that publishes the image to other
+// processes.
+
+TARGET_SSE2
+void copyStreamSSE2(std::uint8_t* dest, const std::uint8_t* src, std::size_t size)
+{
+    std::size_t head = (16 - ((std::uintptr_t)dest & 15)) & 15;
+    std::memcpy(dest, src, head);
+    dest += head;
+    src += head;
+    size -= head;
+    for (std::size_t n = size / 64; n > 0; n--)
+    {
+        __m128i x0 = _mm_loadu_si128((const __m128i*)src + 0);
+        __m128i x1 = _mm_loadu_si128((const __m128i*)src + 1);
+        __m128i x2 = _mm_loadu_si128((const __m128i*)src + 2);
+        __m128i x3 = _mm_loadu_si128((const __m128i*)src + 3);
+        _mm_stream_si128((__m128i*)dest + 0, x0);
+        _mm_stream_si128((__m128i*)dest + 1, x1);
+        _mm_stream_si128((__m128i*)dest + 2, x2);
+        _mm_stream_si128((__m128i*)dest + 3, x3);
+        dest += 64;
+        src += 64;
+    }
+    std::memcpy(dest, src, size % 64);
+}
+
+TARGET_AVX
+void copyStreamAVX(std::uint8_t* dest, const std::uint8_t* src, std::size_t size)
+{
+    std::size_t head = (32 - ((std::uintptr_t)dest & 31)) & 31;
+    std::memcpy(dest, src, head);
+    dest += head;
+    src += head;
+    size -= head;
+    for (std::size_t n = size / 128; n > 0; n--)
+    {
+        __m256i y0 = _mm256_loadu_si256((const __m256i*)src + 0);
+        __m256i y1 = _mm256_loadu_si256((const __m256i*)src + 1);
+        __m256i y2 = _mm256_loadu_si256((const __m256i*)src + 2);
+        __m256i y3 = _mm256_loadu_si256((const __m256i*)src + 3);
+        _mm256_stream_si256((__m256i*)dest + 0, y0);
+        _mm256_stream_si256((__m256i*)dest + 1, y1);
+        _mm256_stream_si256((__m256i*)dest + 2, y2);
+        _mm256_stream_si256((__m256i*)dest + 3, y3);
+        dest += 128;
+        src += 128;
+    }
+    std::memcpy(dest, src, size % 128);
+}
+
+#endif // SOFTCAM_X86
+
+void copyWith(CopyEngine::Method method, void* dest, const void* src, std::size_t size)
+{
+    switch (method)
+    {
+    #if defined(SOFTCAM_X86)
+    case CopyEngine::METHOD_SSE2:
+        copyStreamSSE2(static_cast<std::uint8_t*>(dest), static_cast<const std::uint8_t*>(src), size);
+        break;
+    case CopyEngine::METHOD_AVX:
+        copyStreamAVX(static_cast<std::uint8_t*>(dest), static_cast<const std::uint8_t*>(src), size);
+        break;
+    #endif
+    default:
+        std::memcpy(dest, src, size);
+        break;
+    }
+}
+
+void finishCopy(CopyEngine::Method method)
+{
+    #if defined(SOFTCAM_X86)
+    if (method != CopyEngine::METHOD_MEMCPY)
+    {
+        _mm_sfence();
+    }
+    #else
+    (void)method;
+    #endif
+}
+
+} //namespace
+
+
+void CopyEngine::copy(void* dest, const void* src, std::size_t size)
+{
+    if (size < NON_TEMPORAL_THRESHOLD)
+    {
+        std::memcpy(dest, src, size);
+        return;
+    }
+    copy(bestMethod(), dest, src, size);
+}
+
+void CopyEngine::copy(Method method, void* dest, const void* src, std::size_t size)
+{
+    // Tiny copies are not worth the alignment handling.
+    if (size < 256 || !isSupported(method))
+    {
+        method = METHOD_MEMCPY;
+    }
+    copyWith(method, dest, src, size);
+    finishCopy(method);
+}
+
+void CopyEngine::copyRows(
+                        void*           dest,
+                        std::ptrdiff_t  dest_stride,
+                        const void*     src,
+                        std::ptrdiff_t  src_stride,
+                        std::size_t     row_size,
+                        std::size_t     rows)
+{
+    // Two images without padding in the same row order are copied at once
+    // from their lowest rows in memory, which are the bottom rows if bottom-up.
+    if (dest_stride == src_stride &&
+        (dest_stride == (std::ptrdiff_t)row_size || dest_stride == -(std::ptrdiff_t)row_size))
+    {
+        std::ptrdiff_t offset = dest_stride < 0 ? dest_stride * ((std::ptrdiff_t)rows - 1) : 0;
+        copy(static_cast<std::uint8_t*>(dest) + offset,
+             static_cast<const std::uint8_t*>(src) + offset,
+             row_size * rows);
+        return;
+    }
+    // The method is chosen by the size of the whole image, not of a row.
+    Method method = METHOD_MEMCPY;
+    if (NON_TEMPORAL_THRESHOLD <= row_size * rows && 256 <= row_size)
+    {
+        method = bestMethod();
+    }
+    auto d = static_cast<std::uint8_t*>(dest);
+    auto s = static_cast<const std::uint8_t*>(src);
+    for (std::size_t y = 0; y < rows; y++)
+    {
+        copyWith(method, d, s, row_size);
+        d += dest_stride;
+        s += src_stride;
+    }
+    finishCopy(method);
+}
+
+bool CopyEngine::isSupported(Method method)
+{
+    #if defined(SOFTCAM_X86)
+    static const bool sse2 = detectSSE2();
+    static const bool avx = detectAVX();
+    switch (method)
+    {
+    case METHOD_MEMCPY: return true;
+    case METHOD_SSE2:   return sse2;
+    case METHOD_AVX:    return avx;
+    }
+    return false;
+    #else
+    return method == METHOD_MEMCPY;
+    #endif
+}
+
+CopyEngine::Method CopyEngine::bestMethod()
+{
+    static const Method best =
+        isSupported(METHOD_AVX) ? METHOD_AVX :
+        isSupported(METHOD_SSE2) ? METHOD_SSE2 :
+        METHOD_MEMCPY;
+    return best;
+}
+
+
+} //namespace softcam
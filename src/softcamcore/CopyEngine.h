@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+
+namespace softcam {
+
+
+/// Memory Copy for Frame Images
+///
+/// Images larger than the threshold are copied with non-temporal stores,
+/// which don't pollute the cache of the writer with data that only other
+/// processes will read. The instruction set is selected at runtime.
+class CopyEngine
+{
+ public:
+    enum Method
+    {
+        METHOD_MEMCPY,
+        METHOD_SSE2,
+        METHOD_AVX,
+    };
+
+    static constexpr std::size_t NON_TEMPORAL_THRESHOLD = 4 * 1024 * 1024;
+
+    static void     copy(void* dest, const void* src, std::size_t size);
+    static void     copy(Method method, void* dest, const void* src, std::size_t size);
+    static void     copyRows(
+                        void*           dest,
+                        std::ptrdiff_t  dest_stride,
+                        const void*     src,
+                        std::ptrdiff_t  src_stride,
+                        std::size_t     row_size,
+                        std::size_t     rows);
+    static bool     isSupported(Method method);
+    static Method   bestMethod();
+};
+
+
+} //namespace softcam
@@ -147,6 +147,9 @@ AM_MEDIA_TYPE* makeMediaType(int width, int height, float framerate)
     return amt;
 }
 
+// More buffers than an allocator usually has
+const std::size_t MaxSampleBuffers = 16;
+
 } //namespace
 
 namespace softcam {
@@ -155,17 +158,19 @@ namespace softcam {
 CUnknown * Softcam::CreateInstance(
                     LPUNKNOWN   lpunk,
                     const GUID& clsid,
-                    HRESULT*    phr)
+                    HRESULT*    phr,
+                    const char* instance_name)
 {
     OPEN_LOGFILE();
     LOG("===== logging started =====\n");
 
-    return new Softcam(lpunk, clsid, phr);
+    return new Softcam(lpunk, clsid, phr, instance_name);
 }
 
-Softcam::Softcam(LPUNKNOWN lpunk, const GUID& clsid, HRESULT *phr) :
+Softcam::Softcam(LPUNKNOWN lpunk, const GUID& clsid, HRESULT *phr, const char* instance_name) :
     CSource(NAME("DirectShow Softcam"), lpunk, clsid),
-    m_frame_buffer(FrameBuffer::open()),
+    m_instance_name(instance_name ? instance_name : ""),
+    m_frame_buffer(FrameBuffer::open(m_instance_name.c_str())),
     m_valid(m_frame_buffer ? true : false),
     m_width(m_frame_buffer.width()),
     m_height(m_frame_buffer.height()),
@@ -339,7 +344,7 @@ FrameBuffer* Softcam::getFrameBuffer()
     CAutoLock lock(&m_critsec);
     if (!m_frame_buffer)
     {
-        auto fb = FrameBuffer::open();
+        auto fb = FrameBuffer::open(m_instance_name.c_str());
         if (fb &&
             fb.active() &&
             fb.width() == m_width &&
@@ -411,33 +416,70 @@ HRESULT SoftcamStream::FillBuffer(IMediaSample *pms)
     BYTE *pData;
     pms->GetPointer(&pData);
     long lDataLen = pms->GetSize();
-    ZeroMemory(pData, (std::size_t)lDataLen);
+    const std::size_t size = calcDIBSize(m_width, m_height);
+    auto sample = std::find_if(
+                        m_sample_buffers.begin(), m_sample_buffers.end(),
+                        [&](const SampleBuffer& buffer) { return buffer.m_data == pData; });
+    if (sample == m_sample_buffers.end())
+    {
+        // A buffer we haven't filled yet holds no frame.
+        if (m_sample_buffers.size() >= MaxSampleBuffers)
+        {
+            m_sample_buffers.erase(m_sample_buffers.begin());
+        }
+        m_sample_buffers.push_back({ pData, 0 });
+        sample = m_sample_buffers.end() - 1;
+        if ((std::size_t)lDataLen > size)
+        {
+            ZeroMemory(pData + size, (std::size_t)lDataLen - size);
+        }
+    }
+    bool has_timestamp = false;
+    bool new_frame = false;
+    uint64_t timestamp = 0;
     {
         if (auto fb = getParent()->getFrameBuffer())
         {
             bool active = fb->waitForNewFrame(m_frame_counter);
-            fb->transferToDIB(pData, &m_frame_counter);
+            // The buffer is brought up to date by copying only the tiles
+            // which have changed since the frame it holds, and is left as it
+            // is if it already holds the latest frame.
+            if (sample->m_frame_counter == 0 || sample->m_frame_counter != fb->frameCounter())
+            {
+                fb->refreshDIB(pData, &sample->m_frame_counter, &timestamp);
+                if (sample->m_frame_counter != m_frame_counter)
+                {
+                    m_frame_counter = sample->m_frame_counter;
+                    new_frame = true;
+                }
+            }
+            has_timestamp = fb->hasTimestamps();
 
             if (!active)
             {
                 // The sender has deactivated this stream and stopped sending frames.
                 // We release this stream and will wait a new stream to be available.
                 getParent()->releaseFrameBuffer();
+                m_time_base.restart();
+                m_frame_counter = 0;
+                // The frame counters of the next stream have nothing to do
+                // with the frames the buffers hold.
+                for (auto& buffer : m_sample_buffers)
+                {
+                    buffer.m_frame_counter = 0;
+                }
 
-                // Save the last image for a placeholder.
-                const std::size_t size = calcDIBSize(m_width, m_height);
-                if (!m_screenshot)
+                // Darken the image to indicate that the source is inactive,
+                // and save it for a placeholder.
+                if (!m_placeholder)
                 {
-                    m_screenshot.reset(new uint8_t[size]);
+                    m_placeholder.reset(new uint8_t[size]);
                 }
+                for (std::size_t i = 0; i < size; i++)
                 {
-                    // Darken the image to indicate that the source is inactive.
-                    for (std::size_t i = 0; i < size; i++)
-                    {
-                        pData[i] /= 4;
-                    }
+                    pData[i] /= 4;
                 }
-                std::memcpy(m_screenshot.get(), pData, size);
+                std::memcpy(m_placeholder.get(), pData, size);
             }
         }
         else
@@ -446,11 +488,27 @@ HRESULT SoftcamStream::FillBuffer(IMediaSample *pms)
             m_frame_counter = 0;
             Timer::sleep(0.100f);
 
-            const std::size_t size = calcDIBSize(m_width, m_height);
-            std::memcpy(pData, m_screenshot.get(), size);
+            if (m_placeholder)
+            {
+                std::memcpy(pData, m_placeholder.get(), size);
+            }
+            else
+            {
+                ZeroMemory(pData, size);
+            }
         }
 
         CAutoLock lock(&m_critsec);
+        if (has_timestamp)
+        {
+            // Follow the timing of the frames given by the sender, and the
+            // local clock while the last frame is delivered again, so that
+            // each sample starts later than the previous one.
+            uint64_t time = new_frame ?
+                    m_time_base.map(timestamp, Timer::now()) :
+                    m_time_base.repeat(Timer::now());
+            m_sample_time = (REFERENCE_TIME)(time / 100);
+        }
         CRefTime start = m_sample_time;
         m_sample_time += (LONG)m_interval_time_msec;
         pms->SetTime((REFERENCE_TIME*)&start,(REFERENCE_TIME*)&m_sample_time);
@@ -530,6 +588,9 @@ HRESULT SoftcamStream::OnThreadCreate()
 {
     CAutoLock lock(&m_critsec);
     m_sample_time = 0;
+    m_time_base.reset(Timer::now());
+    // The allocator may have reallocated its buffers since the last run.
+    m_sample_buffers.clear();
     float framerate = getParent()->framerate();
     if (framerate <= 0.0f)
     {
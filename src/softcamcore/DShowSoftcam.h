@@ -1,8 +1,11 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 #include <baseclasses/streams.h>
 #include "FrameBuffer.h"
+#include "TimeBase.h"
 
 
 namespace softcam {
@@ -14,7 +17,8 @@ public:
     static CUnknown* CreateInstance(
                     LPUNKNOWN   lpunk,
                     const GUID& clsid,
-                    HRESULT*    phr);
+                    HRESULT*    phr,
+                    const char* instance_name = nullptr);
 
     // IUnknown Methods
     DECLARE_IUNKNOWN
@@ -35,13 +39,14 @@ public:
 
 private:
     CCritSec    m_critsec;
+    const std::string m_instance_name;
     FrameBuffer m_frame_buffer;
     const bool  m_valid;
     const int   m_width;
     const int   m_height;
     const float m_framerate;
 
-    Softcam(LPUNKNOWN lpunk, const GUID& clsid, HRESULT *phr);
+    Softcam(LPUNKNOWN lpunk, const GUID& clsid, HRESULT *phr, const char* instance_name);
 };
 
 
@@ -88,12 +93,24 @@ private:
     const bool  m_valid;
     const int   m_width;
     const int   m_height;
+    // The last frame delivered, which is delivered again while no new
+    // frame arrives.
     uint64_t    m_frame_counter = 0;
-    std::unique_ptr<uint8_t[]>  m_screenshot;
+    // The frame each buffer of the allocator holds, so that a buffer
+    // already holding the frame to deliver is not written again.
+    struct SampleBuffer
+    {
+        const BYTE* m_data;
+        uint64_t    m_frame_counter;
+    };
+    std::vector<SampleBuffer>   m_sample_buffers;
+    // The last image darkened, which is shown while waiting for a new stream.
+    std::unique_ptr<uint8_t[]>  m_placeholder;
 
     CCritSec m_critsec;
     CRefTime m_sample_time;
     long m_interval_time_msec = 10;
+    TimeBase m_time_base;
 
     Softcam*        getParent();
 };
@@ -1,7 +1,20 @@
 #include "FrameBuffer.h"
 
-#include <windows.h>
+#include <cstring>
+#include <string>
+#include <array>
+#include <atomic>
+#include <vector>
+#include <algorithm>
 #include <mutex> // lock_guard
+#include <thread>
+#include "CopyEngine.h"
+#include "InstanceDirectory.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SOFTCAM_X86
+#include <emmintrin.h>
+#endif
 
 
 namespace softcam {
@@ -9,22 +22,179 @@ namespace softcam {
 
 const char NamedMutexName[] = "DirectShow Softcam/NamedMutex";
 const char SharedMemoryName[] = "DirectShow Softcam/SharedMemory";
-const uint8_t ProtocolVersion = 2;
+const char NamedEventName[] = "DirectShow Softcam/NamedEvent";
+const char InstancePrefix[] = "DirectShow Softcam/Instances/";
+const uint8_t ProtocolVersion = 3;
+const uint32_t LegacyHeaderSize = 24; // the size of the header of version 2 or older
+const uint32_t LayoutMagicV3 = 0x33764353; // "SCv3"; image slots packed right after the header
+const uint32_t LayoutMagicV4 = 0x34764353; // "SCv4"; image slots aligned to pages
+const uint32_t NumImageSlots = 3;
+const uint32_t ImageAlignment = 4096; // a page, which is also a multiple of cache lines
+const uint32_t NumReceiverSlots = FrameBuffer::NUM_RECEIVER_SLOTS;
+const uint32_t NumLatencyBuckets = FrameBuffer::NUM_LATENCY_BUCKETS;
+const uint32_t CacheLineSize = 64;
+const int MaxSpinRetries = 64;
+const int DirtyTileSize = FrameBuffer::DIRTY_TILE_SIZE;
+
+enum ImageFlags : uint32_t
+{
+    // Rows are stored bottom-up, which is the order of a DIB.
+    // Since the width is a multiple of four, each row is DWORD-aligned
+    // without padding, and thus the whole image is exactly a DIB.
+    IMAGE_FLAG_BOTTOM_UP = 0x0001,
+    // Each image slot carries the timestamp of its image.
+    IMAGE_FLAG_TIMESTAMPS = 0x0002,
+    // The header is followed by the statistics.
+    IMAGE_FLAG_STATS = 0x0004,
+    // Each image slot has a bitmap of the tiles which have changed since
+    // the previous frame, placed after the header.
+    IMAGE_FLAG_DIRTY_TILES = 0x0008,
+};
+
+constexpr uint32_t alignUp(uint32_t value, uint32_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
 
 
 struct FrameBuffer::Header
 {
+    // The offset of the latest image.
+    // This is accessed only while holding the mutex.
     uint32_t    m_image_offset;
+
+    // The following fields are written only once by the sender while it is
+    // holding the mutex to initialize the shared memory, and a receiver
+    // reads them with the mutex too when it opens the shared memory.
+    // After that, they are immutable and can be read without the mutex.
     uint16_t    m_width;
     uint16_t    m_height;
     float       m_framerate;
-    uint8_t     m_is_active;
-    uint8_t     m_connected_min_version; // 0 or 1 or 2
-    uint8_t     m_watchdog_sender_heartbeat;
-    uint8_t     m_watchdog_receiver_heartbeat;
-    uint64_t    m_frame_counter;
+
+    // The following fields change during the lifetime of the stream.
+    // Each of them is a naturally aligned lock-free atomic so that
+    // the status can be read and the heartbeats can be incremented without
+    // taking the mutex. Peers of older versions increment the heartbeats
+    // with the mutex held, and an increment lost by racing with them is
+    // harmless since the watchdogs only look for changes.
+    std::atomic<uint8_t>    m_is_active;
+    std::atomic<uint8_t>    m_connected_min_version; // 0 or 1 or 2 or 3
+    std::atomic<uint8_t>    m_watchdog_sender_heartbeat;
+    std::atomic<uint8_t>    m_watchdog_receiver_heartbeat;
+    std::atomic<uint64_t>   m_frame_counter;
+
+    // The following fields are the extension of version 3.
+    // The sender writes each frame into one of the image slots which is not
+    // the latest one and then publishes it as the latest one.
+    // Each slot is guarded by a sequence lock (the sequence number is odd
+    // while the slot is being written), so that receivers can copy the
+    // latest image without blocking the sender.
+    // Receivers of older versions don't know this extension and read the
+    // image at m_image_offset with the mutex held, which always refers to
+    // the latest slot, and the sender never writes to the latest slot.
+    struct ImageSlot
+    {
+        std::atomic<uint32_t>   m_sequence;
+        uint32_t                m_reserved;
+        std::atomic<uint64_t>   m_frame_counter;
+    };
+    uint32_t                m_layout_magic;
+    uint32_t                m_slot_offset[NumImageSlots];
+    std::atomic<uint32_t>   m_latest_slot;
+    ImageSlot               m_slots[NumImageSlots];
+
+    // The following fields are the extension of the page-aligned layout.
+    // Senders of earlier builds leave them zero, as the header is padded
+    // to a page filled with zero.
+    // m_image_flags is a combination of ImageFlags, immutable after the
+    // initialization.
+    uint32_t                m_image_flags;
+    uint32_t                m_num_receiver_slots;
+
+    // The sender process, so that receivers can tell right away that it
+    // has terminated without waiting for the watchdog to time out.
+    // Zero if unknown. Immutable after the initialization.
+    uint32_t                m_sender_process_id;
+    uint64_t                m_sender_start_time;
+
+    // Each receiver takes one of the slots, each of which occupies its own
+    // cache line, and beats its heartbeat there instead of the shared
+    // m_watchdog_receiver_heartbeat, so that receivers don't write to the
+    // cache line the sender writes on every frame nor to each other's.
+    // Receivers which don't find a free slot use the shared field instead.
+    // m_claim is odd while the slot is in use, and is incremented both when
+    // a receiver claims the slot and when the slot is freed, so that its
+    // value identifies the claim. A receiver whose slot has been reclaimed
+    // can tell that it no longer owns the slot, and can't free the slot
+    // once another receiver has claimed it.
+    // The process of the receiver is written before m_claim is set.
+    struct alignas(CacheLineSize) ReceiverSlot
+    {
+        std::atomic<uint32_t>   m_claim;
+        std::atomic<uint32_t>   m_heartbeat;
+        std::atomic<uint32_t>   m_process_id;
+        std::atomic<uint64_t>   m_start_time;
+    };
+    ReceiverSlot            m_receivers[NumReceiverSlots];
+
+    // The timestamp of the image in each image slot in nanoseconds, given
+    // by the application or taken from Timer::now() when the image was
+    // committed. Valid if IMAGE_FLAG_TIMESTAMPS is set, and written with
+    // the image under the sequence lock of the slot.
+    std::atomic<uint64_t>   m_slot_timestamps[NumImageSlots];
+
+    // The following fields are the statistics, valid if IMAGE_FLAG_STATS is
+    // set. They are counters updated with relaxed atomics by the process
+    // concerned, and anyone can take a snapshot of them at any time without
+    // the mutex. Each group sits on its own cache lines so that updating
+    // one doesn't disturb the others.
+    struct alignas(CacheLineSize) SenderStats
+    {
+        std::atomic<uint64_t>   m_paced_frames;     // frames the sender slept for
+        std::atomic<uint64_t>   m_late_frames;      // frames given after their time
+        std::atomic<uint64_t>   m_oversleep;        // total in nanoseconds
+        std::atomic<uint64_t>   m_max_oversleep;
+        std::atomic<uint64_t>   m_undersleep;
+        std::atomic<uint64_t>   m_unchanged_frames; // frames not written as they were the same
+        // The time each image slot was committed on Timer::now(), written
+        // with the image under the sequence lock of the slot.
+        std::atomic<uint64_t>   m_commit_times[NumImageSlots];
+        // The percentiles of the pacing jitter over the recent frames,
+        // in nanoseconds, published by the sender every few frames.
+        std::atomic<uint64_t>   m_jitter_p50;
+        std::atomic<uint64_t>   m_jitter_p99;
+    };
+    struct alignas(CacheLineSize) LockStats
+    {
+        std::atomic<uint64_t>   m_waits;
+        std::atomic<uint64_t>   m_wait_time;        // total in nanoseconds
+        std::atomic<uint64_t>   m_max_wait_time;
+    };
+    // Written by the receiver holding the receiver slot of the same index.
+    struct alignas(CacheLineSize) ReceiverStats
+    {
+        std::atomic<uint64_t>   m_frames_read;
+        std::atomic<uint64_t>   m_frames_skipped;
+        std::atomic<uint64_t>   m_frame_counter;    // of the last frame read
+        std::atomic<uint64_t>   m_latency;          // total in nanoseconds
+        std::atomic<uint32_t>   m_latency_histogram[NumLatencyBuckets];
+    };
+    SenderStats             m_sender_stats;
+    LockStats               m_lock_stats;
+    ReceiverStats           m_receiver_stats[NumReceiverSlots];
+
+    // The offset of the bitmaps of the dirty tiles, valid if
+    // IMAGE_FLAG_DIRTY_TILES is set. The image is divided into tiles of
+    // DirtyTileSize pixels square in row-major order, and each image slot
+    // has a bitmap of them in 64-bit words, in which a bit is set if the
+    // tile has changed from the previous frame. The bitmaps of the slots
+    // are placed in a row after the header, and each of them is written
+    // with the image under the sequence lock of the slot.
+    uint32_t                m_dirty_tiles_offset;
 
     uint8_t*    imageData();
+    uint8_t*    slotData(uint32_t slot);
+    uint64_t*   dirtyTiles(uint32_t slot, uint32_t words);
 };
 
 
@@ -34,14 +204,187 @@ uint8_t* FrameBuffer::Header::imageData()
     return image;
 }
 
+uint8_t* FrameBuffer::Header::slotData(uint32_t slot)
+{
+    uint8_t *image = reinterpret_cast<uint8_t*>(this) + m_slot_offset[slot];
+    return image;
+}
+
+uint64_t* FrameBuffer::Header::dirtyTiles(uint32_t slot, uint32_t words)
+{
+    uint8_t *bitmaps = reinterpret_cast<uint8_t*>(this) + m_dirty_tiles_offset;
+    return reinterpret_cast<uint64_t*>(bitmaps) + (std::size_t)words * slot;
+}
+
+
+namespace {
+
+bool isNamedInstance(const char* name)
+{
+    return name && *name;
+}
+
+// The default instance uses the same names as older versions do
+// so that it can communicate with them.
+// Each named instance has its own set of names.
+struct ObjectNames
+{
+    std::string m_mutex;
+    std::string m_shmem;
+    std::string m_event;
+
+    explicit ObjectNames(const char* name) :
+        m_mutex(NamedMutexName),
+        m_shmem(SharedMemoryName),
+        m_event(NamedEventName)
+    {
+        if (isNamedInstance(name))
+        {
+            std::string prefix = std::string(InstancePrefix) + name;
+            m_mutex = prefix + "/NamedMutex";
+            m_shmem = prefix + "/SharedMemory";
+            m_event = prefix + "/NamedEvent";
+        }
+    }
+};
+
+
+// Waits a moment before reading the image slots again after finding the
+// sender writing them. The CPU is relaxed for the first retries, and then
+// the thread yields, so that the sender can finish the write even if it
+// has to share a core with us.
+void backOff(int* retries)
+{
+    if (*retries < MaxSpinRetries)
+    {
+        #if defined(SOFTCAM_X86)
+        _mm_pause();
+        #endif
+    }
+    else
+    {
+        std::this_thread::yield();
+    }
+    *retries += 1;
+}
+
+void updateMax(std::atomic<uint64_t>& max, uint64_t value)
+{
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (current < value &&
+           !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+// Bucket 0 is for latencies below 1 microsecond, and bucket i is for
+// those below 2^i microseconds. The last bucket takes all the rest.
+uint32_t latencyBucket(uint64_t latency)
+{
+    uint64_t usec = latency / 1000;
+    uint32_t bucket = 0;
+    while (usec != 0 && bucket + 1 < NumLatencyBuckets)
+    {
+        usec >>= 1;
+        bucket += 1;
+    }
+    return bucket;
+}
+
+// The tiles of an image which are tracked by the bitmaps of dirty tiles.
+struct TileGrid
+{
+    int         m_columns;
+    int         m_rows;
+
+    TileGrid(int width, int height) :
+        m_columns((width + DirtyTileSize - 1) / DirtyTileSize),
+        m_rows((height + DirtyTileSize - 1) / DirtyTileSize)
+    {}
+    uint32_t    words() const { return ((uint32_t)m_columns * m_rows + 63) / 64; }
+};
+
+bool testTile(const std::vector<uint64_t>& tiles, int index)
+{
+    return (tiles[index / 64] >> (index % 64)) & 1;
+}
+
+void setTile(std::vector<uint64_t>& tiles, int index)
+{
+    tiles[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+// Calls fn(x, y, width, height) with each run of the tiles in a row of
+// tiles set in the bitmap, clipped to the image, so that adjacent tiles
+// are copied together.
+template <typename Fn>
+void forEachTileRun(
+            const std::vector<uint64_t>&    tiles,
+            const TileGrid&                 grid,
+            int                             width,
+            int                             height,
+            Fn                              fn)
+{
+    for (int ty = 0; ty < grid.m_rows; ty++)
+    {
+        for (int tx = 0; tx < grid.m_columns; tx++)
+        {
+            if (!testTile(tiles, ty * grid.m_columns + tx))
+            {
+                continue;
+            }
+            int end = tx + 1;
+            while (end < grid.m_columns && testTile(tiles, ty * grid.m_columns + end))
+            {
+                end += 1;
+            }
+            int x = tx * DirtyTileSize;
+            int y = ty * DirtyTileSize;
+            fn(x, y,
+               std::min(end * DirtyTileSize, width) - x,
+               std::min(y + DirtyTileSize, height) - y);
+            tx = end;
+        }
+    }
+}
+
+void copyImageToDIB(void* dest_bits, const uint8_t* image, int width, int height)
+{
+    int gap = ((width * 3 + 3) & ~3) - width * 3;
+    uint8_t* dest = (uint8_t*)dest_bits;
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* src = image + 3 * width * (height - 1 - y);
+        std::memcpy(dest, src, 3 * (uint32_t)width);
+        dest += 3 * width + gap;
+    }
+}
+
+// The entry of a named instance in the directory
+struct Registration
+{
+    InstanceDirectory   m_directory;
+    std::string         m_name;
+};
+
+} //namespace
+
 
 FrameBuffer FrameBuffer::create(
                         int             width,
                         int             height,
-                        float           framerate)
+                        float           framerate,
+                        const char*     name,
+                        bool            bottom_up)
 {
-    FrameBuffer fb(NamedMutexName);
+    const bool valid_name = !isNamedInstance(name) || InstanceDirectory::isValidName(name);
+    const ObjectNames names(valid_name ? name : nullptr);
+    FrameBuffer fb(names.m_mutex.c_str(), names.m_event.c_str());
 
+    if (!valid_name)
+    {
+        return fb;
+    }
     if (!checkDimensions(width, height))
     {
         return fb;
@@ -52,13 +395,21 @@ FrameBuffer FrameBuffer::create(
     }
 
     auto shmem_size = calcMemorySize((uint16_t)width, (uint16_t)height);
-    fb.m_shmem = SharedMemory::create(SharedMemoryName, shmem_size);
+    fb.m_shmem = SharedMemory::create(names.m_shmem.c_str(), shmem_size);
+    if (!fb.m_shmem && removeAbandoned(names.m_shmem.c_str(), fb.m_mutex))
+    {
+        fb.m_shmem = SharedMemory::create(names.m_shmem.c_str(), shmem_size);
+    }
     if (fb.m_shmem)
     {
         std::lock_guard<NamedMutex> lock(fb.m_mutex);
 
+        static_assert(sizeof(Header) <= ImageAlignment, "the header should fit in a page");
+        uint32_t image_size = (uint32_t)width * (uint32_t)height * 3;
         auto frame = fb.header();
-        frame->m_image_offset = sizeof(Header);
+        uint32_t header_size = calcHeaderSize((uint16_t)width, (uint16_t)height);
+        uint32_t slot_size = alignUp(image_size, ImageAlignment);
+        frame->m_image_offset = header_size;
         frame->m_width = (uint16_t)width;
         frame->m_height = (uint16_t)height;
         frame->m_framerate = framerate;
@@ -67,91 +418,386 @@ FrameBuffer FrameBuffer::create(
         frame->m_watchdog_sender_heartbeat = 0;
         frame->m_watchdog_receiver_heartbeat = 0;
         frame->m_frame_counter = 0;
+        frame->m_layout_magic = LayoutMagicV4;
+        for (uint32_t i = 0; i < NumImageSlots; i++)
+        {
+            frame->m_slot_offset[i] = header_size + slot_size * i;
+            frame->m_slots[i].m_sequence = 0;
+            frame->m_slots[i].m_frame_counter = 0;
+            frame->m_slot_timestamps[i] = 0;
+        }
+        frame->m_latest_slot = 0;
+        frame->m_image_flags = IMAGE_FLAG_TIMESTAMPS | IMAGE_FLAG_STATS | IMAGE_FLAG_DIRTY_TILES |
+                                (bottom_up ? (uint32_t)IMAGE_FLAG_BOTTOM_UP : 0);
+        frame->m_num_receiver_slots = NumReceiverSlots;
+        frame->m_sender_process_id = Process::currentId();
+        frame->m_sender_start_time = Process::startTime(frame->m_sender_process_id);
+        for (auto& receiver : frame->m_receivers)
+        {
+            receiver.m_claim = 0;
+            receiver.m_heartbeat = 0;
+            receiver.m_process_id = 0;
+            receiver.m_start_time = 0;
+        }
+        std::memset((void*)&frame->m_sender_stats, 0, sizeof(frame->m_sender_stats));
+        std::memset((void*)&frame->m_lock_stats, 0, sizeof(frame->m_lock_stats));
+        std::memset((void*)&frame->m_receiver_stats, 0, sizeof(frame->m_receiver_stats));
+        frame->m_dirty_tiles_offset = alignUp((uint32_t)sizeof(Header), CacheLineSize);
+        std::memset(frame->dirtyTiles(0, 0), 0,
+                    sizeof(uint64_t) * TileGrid(width, height).words() * NumImageSlots);
+        fb.m_image_flags = frame->m_image_flags;
 
-        auto mutex = fb.m_mutex;
+        // The heartbeats and the monitors never take the mutex, since they
+        // run on the scheduler thread shared by every watchdog of the
+        // process, and a long copy by a peer holding the mutex would
+        // delay all of them enough to be taken as disconnections.
         fb.m_sender_watchdog = Watchdog::createHeartbeat(
             WATCHDOG_HEARTBEAT_INTERVAL,
-            [mutex, frame]() mutable
+            [frame]()
             {
-                std::lock_guard<NamedMutex> lock(mutex);
-                frame->m_watchdog_sender_heartbeat += 1;
+                frame->m_watchdog_sender_heartbeat.fetch_add(1, std::memory_order_relaxed);
             });
+        // The sum of all heartbeats changes as long as any receiver is alive.
+        // The slot of a receiver that has missed a beat is reclaimed at once
+        // if its process has terminated, or after a while otherwise since
+        // the process may not be visible to us.
+        // Once every receiver has a slot, which is the case unless receivers
+        // of older versions or too many receivers are connected, the shared
+        // heartbeat stays quiet and the slots alone tell whether any
+        // receiver remains.
+        const int max_idle_count = 2 * (int)(WATCHDOG_TIMEOUT / WATCHDOG_MONITOR_INTERVAL);
+        const int quiet_count = (int)(WATCHDOG_TIMEOUT / WATCHDOG_MONITOR_INTERVAL);
+        auto receivers_gone = std::make_shared<std::atomic<bool>>(false);
+        fb.m_receivers_gone = receivers_gone;
         fb.m_receiver_watchdog = Watchdog::createMonitor(
             WATCHDOG_MONITOR_INTERVAL,
             WATCHDOG_TIMEOUT,
-            [mutex, frame]() mutable
+            [frame, max_idle_count, quiet_count, receivers_gone,
+             claims = std::array<uint32_t, NumReceiverSlots>{},
+             last = std::array<uint32_t, NumReceiverSlots>{},
+             idle = std::array<int, NumReceiverSlots>{},
+             last_shared = (uint8_t)0,
+             shared_idle = quiet_count]() mutable
             {
-                std::lock_guard<NamedMutex> lock(mutex);
-                return frame->m_watchdog_receiver_heartbeat;
+                uint8_t shared = frame->m_watchdog_receiver_heartbeat.load(std::memory_order_relaxed);
+                unsigned sum = shared;
+                bool any_slot = false;
+                for (uint32_t i = 0; i < NumReceiverSlots; i++)
+                {
+                    auto& receiver = frame->m_receivers[i];
+                    uint32_t claim = receiver.m_claim.load(std::memory_order_acquire);
+                    if (!(claim & 1))
+                    {
+                        idle[i] = 0;
+                        continue;
+                    }
+                    uint32_t heartbeat = receiver.m_heartbeat.load(std::memory_order_relaxed);
+                    sum += heartbeat;
+                    if (heartbeat != last[i] || claim != claims[i])
+                    {
+                        claims[i] = claim;
+                        last[i] = heartbeat;
+                        idle[i] = 0;
+                    }
+                    else if (max_idle_count <= ++idle[i] ||
+                             !Process::isAlive(
+                                    receiver.m_process_id.load(std::memory_order_relaxed),
+                                    receiver.m_start_time.load(std::memory_order_relaxed)))
+                    {
+                        // This fails if the receiver has freed the slot
+                        // or another receiver has claimed it meanwhile.
+                        receiver.m_claim.compare_exchange_strong(claim, claim + 1, std::memory_order_relaxed);
+                        idle[i] = 0;
+                        continue;
+                    }
+                    any_slot = true;
+                }
+                if (shared != last_shared)
+                {
+                    last_shared = shared;
+                    shared_idle = 0;
+                }
+                else if (shared_idle < quiet_count)
+                {
+                    shared_idle += 1;
+                }
+                receivers_gone->store(!any_slot && quiet_count <= shared_idle, std::memory_order_relaxed);
+                return sum;
+            });
+    }
+    if (fb.m_shmem && isNamedInstance(name))
+    {
+        // Make the instance visible to receivers until the last copy
+        // of this frame buffer is released.
+        // The directory is kept open along with the entry, since on Windows
+        // the directory itself is gone once the last handle is closed.
+        auto registration = new Registration{ InstanceDirectory::open(), name };
+        if (!registration->m_directory.add(name))
+        {
+            delete registration;
+            fb.release();
+            return fb;
+        }
+        fb.m_registration.reset(
+            registration,
+            [](void* ptr)
+            {
+                auto registration = static_cast<Registration*>(ptr);
+                registration->m_directory.remove(registration->m_name.c_str());
+                delete registration;
             });
     }
     return fb;
 }
 
-FrameBuffer FrameBuffer::open()
+FrameBuffer FrameBuffer::open(const char* name)
 {
-    FrameBuffer fb(NamedMutexName);
+    const bool valid_name = !isNamedInstance(name) || InstanceDirectory::isValidName(name);
+    const ObjectNames names(valid_name ? name : nullptr);
+    FrameBuffer fb(names.m_mutex.c_str(), names.m_event.c_str());
 
-    fb.m_shmem = SharedMemory::open(SharedMemoryName);
+    if (!valid_name)
+    {
+        return fb;
+    }
+    if (isNamedInstance(name) && !InstanceDirectory::open().contains(name))
+    {
+        return fb;
+    }
+    fb.m_shmem = SharedMemory::open(names.m_shmem.c_str());
     if (fb.m_shmem)
     {
         std::lock_guard<NamedMutex> lock(fb.m_mutex);
 
-        auto size = fb.m_shmem.size();
-        if (size < sizeof(Header))
+        bool has_extension = false;
+        if (!fb.checkLayout(&has_extension))
         {
             fb.m_shmem = {};
             return fb;
         }
         auto frame = fb.header();
-        if (!checkDimensions(frame->m_width, frame->m_height) ||
-            frame->m_framerate < 0.0f)
+
+        Header::ReceiverSlot* slot = nullptr;
+        uint32_t claim = 0;
+        if (has_extension)
         {
-            fb.m_shmem = {};
-            return fb;
+            if (frame->m_num_receiver_slots == NumReceiverSlots)
+            {
+                for (auto& receiver : frame->m_receivers)
+                {
+                    // Claims are serialized by the mutex, and a free slot
+                    // changes only by being claimed.
+                    claim = receiver.m_claim.load(std::memory_order_relaxed);
+                    if (!(claim & 1))
+                    {
+                        if (fb.m_image_flags & IMAGE_FLAG_STATS)
+                        {
+                            // The statistics of the previous holder are no longer ours.
+                            auto& stats = frame->m_receiver_stats[&receiver - frame->m_receivers];
+                            std::memset((void*)&stats, 0, sizeof(stats));
+                        }
+                        uint32_t process_id = Process::currentId();
+                        receiver.m_process_id.store(process_id, std::memory_order_relaxed);
+                        receiver.m_start_time.store(Process::startTime(process_id), std::memory_order_relaxed);
+                        claim += 1;
+                        receiver.m_claim.store(claim, std::memory_order_release);
+                        slot = &receiver;
+                        break;
+                    }
+                }
+            }
         }
-        uint32_t image_size = (uint32_t)frame->m_width * (uint32_t)frame->m_height * 3;
-        if (size <= frame->m_image_offset ||
-            size - frame->m_image_offset < image_size)
+        if (slot)
         {
-            fb.m_shmem = {};
-            return fb;
+            // The slot is freed when the last copy of this frame buffer
+            // is released, unless the sender has reclaimed it meanwhile.
+            auto shmem = fb.m_shmem;
+            fb.m_receiver_slot.reset(
+                slot,
+                [shmem, claim](void* ptr)
+                {
+                    uint32_t expected = claim;
+                    static_cast<Header::ReceiverSlot*>(ptr)->m_claim.compare_exchange_strong(
+                                                                    expected, claim + 1);
+                });
+            fb.m_receiver_claim = claim;
         }
 
-        auto mutex = fb.m_mutex;
         fb.m_sender_watchdog = Watchdog::createMonitor(
             WATCHDOG_MONITOR_INTERVAL,
             WATCHDOG_TIMEOUT,
-            [mutex, frame]() mutable
+            [frame]()
             {
-                std::lock_guard<NamedMutex> lock(mutex);
-                return frame->m_watchdog_sender_heartbeat;
-            });
-        fb.m_receiver_watchdog = Watchdog::createHeartbeat(
-            WATCHDOG_HEARTBEAT_INTERVAL,
-            [mutex, frame]() mutable
-            {
-                std::lock_guard<NamedMutex> lock(mutex);
-                frame->m_watchdog_receiver_heartbeat += 1;
+                return frame->m_watchdog_sender_heartbeat.load(std::memory_order_relaxed);
             });
+        if (slot)
+        {
+            // Once the slot has been reclaimed, the receiver falls back to
+            // the shared heartbeat so that it is still seen alive.
+            fb.m_receiver_watchdog = Watchdog::createHeartbeat(
+                WATCHDOG_HEARTBEAT_INTERVAL,
+                [frame, slot, claim]()
+                {
+                    if (slot->m_claim.load(std::memory_order_relaxed) == claim)
+                    {
+                        slot->m_heartbeat.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        frame->m_watchdog_receiver_heartbeat.fetch_add(1, std::memory_order_relaxed);
+                    }
+                });
+            slot->m_heartbeat += 1;
+        }
+        else
+        {
+            fb.m_receiver_watchdog = Watchdog::createHeartbeat(
+                WATCHDOG_HEARTBEAT_INTERVAL,
+                [frame]()
+                {
+                    frame->m_watchdog_receiver_heartbeat.fetch_add(1, std::memory_order_relaxed);
+                });
+            frame->m_watchdog_receiver_heartbeat += 1;
+        }
         if (0 == frame->m_connected_min_version ||
             ProtocolVersion <= frame->m_connected_min_version)
         {
             frame->m_connected_min_version = ProtocolVersion;
         }
-        frame->m_watchdog_receiver_heartbeat += 1;
+
+        // Wake up the sender waiting for a connection.
+        fb.m_event.notify();
     }
 
     return fb;
 }
 
+// Attaches to the frame buffer only to look at it, for monitoring tools.
+// Unlike open(), this maps the shared memory read-only and leaves no trace
+// in it; the observer doesn't take a receiver slot, doesn't beat the
+// receiver heartbeat and doesn't change m_connected_min_version, so the
+// sender doesn't see it as a receiver.
+FrameBuffer FrameBuffer::observe(const char* name)
+{
+    const bool valid_name = !isNamedInstance(name) || InstanceDirectory::isValidName(name);
+    const ObjectNames names(valid_name ? name : nullptr);
+    FrameBuffer fb(names.m_mutex.c_str(), names.m_event.c_str());
+
+    if (!valid_name)
+    {
+        return fb;
+    }
+    if (isNamedInstance(name) && !InstanceDirectory::open().contains(name))
+    {
+        return fb;
+    }
+    fb.m_shmem = SharedMemory::openReadOnly(names.m_shmem.c_str());
+    if (fb.m_shmem)
+    {
+        std::lock_guard<NamedMutex> lock(fb.m_mutex);
+
+        bool has_extension = false;
+        if (!fb.checkLayout(&has_extension))
+        {
+            fb.m_shmem = {};
+            return fb;
+        }
+        fb.m_read_only = true;
+    }
+    return fb;
+}
+
+// Checks the header of the opened shared memory and finds which layout
+// it has. This is called with the mutex held.
+bool FrameBuffer::checkLayout(bool* out_has_extension)
+{
+    *out_has_extension = false;
+    auto size = m_shmem.size();
+    if (size < LegacyHeaderSize)
+    {
+        return false;
+    }
+    auto frame = header();
+    if (!checkDimensions(frame->m_width, frame->m_height) ||
+        frame->m_framerate < 0.0f)
+    {
+        return false;
+    }
+    uint32_t image_size = (uint32_t)frame->m_width * (uint32_t)frame->m_height * 3;
+    if (size <= frame->m_image_offset ||
+        size - frame->m_image_offset < image_size)
+    {
+        return false;
+    }
+    // Senders of version 2 or older put the image right after
+    // the header of the older layout.
+    // Senders of earlier builds of version 3 put the slots right after
+    // the header without the page-aligned extension, which we can still
+    // read as the offsets are explicit.
+    const uint32_t packed_header_size = (uint32_t)offsetof(Header, m_image_flags);
+    m_legacy_layout = frame->m_image_offset < packed_header_size;
+    if (!m_legacy_layout)
+    {
+        if (frame->m_layout_magic != LayoutMagicV3 &&
+            frame->m_layout_magic != LayoutMagicV4)
+        {
+            return false;
+        }
+        *out_has_extension = frame->m_layout_magic != LayoutMagicV3;
+        uint32_t header_size = *out_has_extension ? (uint32_t)sizeof(Header) : packed_header_size;
+        for (uint32_t i = 0; i < NumImageSlots; i++)
+        {
+            if (frame->m_slot_offset[i] < header_size ||
+                size <= frame->m_slot_offset[i] ||
+                size - frame->m_slot_offset[i] < image_size)
+            {
+                return false;
+            }
+        }
+    }
+    if (*out_has_extension)
+    {
+        if (frame->m_image_flags & IMAGE_FLAG_DIRTY_TILES)
+        {
+            uint32_t bitmaps_size = (uint32_t)sizeof(uint64_t) *
+                    TileGrid(frame->m_width, frame->m_height).words() * NumImageSlots;
+            if (frame->m_dirty_tiles_offset < sizeof(Header))
+            {
+                return false;
+            }
+            for (uint32_t i = 0; i < NumImageSlots; i++)
+            {
+                if (frame->m_slot_offset[i] < frame->m_dirty_tiles_offset ||
+                    frame->m_slot_offset[i] - frame->m_dirty_tiles_offset < bitmaps_size)
+                {
+                    return false;
+                }
+            }
+        }
+        m_image_flags = frame->m_image_flags;
+    }
+    return true;
+}
+
 FrameBuffer&
 FrameBuffer::operator =(const FrameBuffer& fb)
 {
     m_receiver_watchdog = {};
     m_sender_watchdog = {};
+    m_receiver_slot = {};
+    m_receivers_gone = {};
     m_shmem = {};
+    m_registration = {};
+    m_mutex = fb.m_mutex;
+    m_event = fb.m_event;
     m_shmem = fb.m_shmem;
+    m_registration = fb.m_registration;
+    m_receiver_slot = fb.m_receiver_slot;
+    m_receiver_claim = fb.m_receiver_claim;
+    m_receivers_gone = fb.m_receivers_gone;
+    m_legacy_layout = fb.m_legacy_layout;
+    m_read_only = fb.m_read_only;
+    m_image_flags = fb.m_image_flags;
     m_sender_watchdog = fb.m_sender_watchdog;
     m_receiver_watchdog = fb.m_receiver_watchdog;
     return *this;
@@ -164,40 +810,46 @@ void* FrameBuffer::handle() const
 
 int FrameBuffer::width() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
     return m_shmem ? header()->m_width : 0;
 }
 
 int FrameBuffer::height() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
     return m_shmem ? header()->m_height : 0;
 }
 
 float FrameBuffer::framerate() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
     return m_shmem ? header()->m_framerate : 0.0f;
 }
 
+bool FrameBuffer::bottomUp() const
+{
+    if (!m_shmem) return false;
+    return (m_image_flags & IMAGE_FLAG_BOTTOM_UP) != 0;
+}
+
+bool FrameBuffer::hasTimestamps() const
+{
+    if (!m_shmem) return false;
+    return (m_image_flags & IMAGE_FLAG_TIMESTAMPS) != 0;
+}
+
 uint64_t FrameBuffer::frameCounter() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
-    return m_shmem ? header()->m_frame_counter : 0;
+    return m_shmem ? header()->m_frame_counter.load(std::memory_order_acquire) : 0;
 }
 
 bool FrameBuffer::active() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
-    return m_shmem && header()->m_is_active;
+    return m_shmem && header()->m_is_active.load(std::memory_order_acquire);
 }
 
 bool FrameBuffer::connected() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
     if (m_shmem)
     {
-        auto ver = header()->m_connected_min_version;
+        auto ver = header()->m_connected_min_version.load(std::memory_order_acquire);
         if (0 == ver)
         {
             // No receivers connected
@@ -210,53 +862,446 @@ bool FrameBuffer::connected() const
             // we won't know their disconnection.
             return true;
         }
-        return m_receiver_watchdog.alive();
+        if (!m_receiver_watchdog.alive())
+        {
+            return false;
+        }
+        // A receiver may have taken a slot since the monitor looked.
+        return !m_receivers_gone || !m_receivers_gone->load(std::memory_order_relaxed) ||
+                anyReceiverSlotInUse();
     }
     return false;
 }
 
 void FrameBuffer::deactivate()
 {
-    if (!m_shmem) return;
-    std::lock_guard<NamedMutex> lock(m_mutex);
-    header()->m_is_active = 0;
+    if (!m_shmem || m_read_only) return;
+    header()->m_is_active.store(0, std::memory_order_release);
+    m_event.notify();
 }
 
 void FrameBuffer::write(const void* image_bits)
+{
+    write(image_bits, Timer::now());
+}
+
+void FrameBuffer::write(const void* image_bits, uint64_t timestamp)
 {
     if (!m_shmem) return;
-    std::lock_guard<NamedMutex> lock(m_mutex);
+    write(image_bits, (std::ptrdiff_t)3 * header()->m_width, timestamp);
+}
+
+// Writes an image whose rows are `stride` bytes apart, starting from the top
+// row at `image_bits`. The stride is negative for a bottom-up image.
+void FrameBuffer::write(const void* image_bits, std::ptrdiff_t stride, uint64_t timestamp)
+{
+    if (!m_shmem || m_read_only) return;
+    auto frame = header();
+    int dest_stride = 0;
+    void* dest = acquireImage(&dest_stride);
+    std::size_t row_size = (std::size_t)3 * frame->m_width;
+    CopyEngine::copyRows(
+            dest, dest_stride,
+            image_bits, stride,
+            row_size, frame->m_height);
+    commitImage(timestamp);
+}
+
+// Writes only the given rectangles of an image, which is laid out in the same
+// way as write() takes, and leaves the rest of the latest image as it is.
+// The slot to be written holds an older image, so the tiles which have
+// changed since then are brought up to date from the latest slot first,
+// except those which are about to be overwritten entirely.
+void FrameBuffer::writeRegions(const void* image_bits, const Rect* rects, int count, uint64_t timestamp)
+{
+    if (!m_shmem || m_read_only) return;
+    if (!(m_image_flags & IMAGE_FLAG_DIRTY_TILES))
+    {
+        write(image_bits, timestamp);
+        return;
+    }
     auto frame = header();
-    std::memcpy(
-            frame->imageData(),
-            image_bits,
-            (std::size_t)3 * frame->m_width * frame->m_height);
-    frame->m_frame_counter += 1;
+    const int w = frame->m_width;
+    const int h = frame->m_height;
+    const TileGrid grid(w, h);
+    const uint32_t words = grid.words();
+
+    uint32_t latest = frame->m_latest_slot.load(std::memory_order_relaxed) % NumImageSlots;
+    uint32_t slot = (latest + 1) % NumImageSlots;
+    std::vector<uint64_t> stale(words, 0);
+    if (frame->m_slots[slot].m_sequence.load(std::memory_order_relaxed) & 1)
+    {
+        // An application has been writing into the slot.
+        std::fill(stale.begin(), stale.end(), ~(uint64_t)0);
+    }
+    else
+    {
+        // The frames after the one in the slot are in the other slots,
+        // unless frames have been written in some other order.
+        uint64_t slot_counter = frame->m_slots[slot].m_frame_counter.load(std::memory_order_relaxed);
+        uint64_t frame_counter = frame->m_frame_counter.load(std::memory_order_relaxed);
+        uint64_t newer = 0;
+        for (uint32_t i = 0; i < NumImageSlots; i++)
+        {
+            if (i != slot && slot_counter < frame->m_slots[i].m_frame_counter.load(std::memory_order_relaxed))
+            {
+                const uint64_t* tiles = frame->dirtyTiles(i, words);
+                for (uint32_t j = 0; j < words; j++)
+                {
+                    stale[j] |= tiles[j];
+                }
+                newer += 1;
+            }
+        }
+        if (slot_counter + newer != frame_counter)
+        {
+            std::fill(stale.begin(), stale.end(), ~(uint64_t)0);
+        }
+    }
+
+    std::vector<uint64_t> dirty(words, 0);
+    std::vector<Rect> clipped;
+    clipped.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        int x0 = std::max(rects[i].x, 0);
+        int y0 = std::max(rects[i].y, 0);
+        int x1 = std::min(rects[i].x + std::max(rects[i].width, 0), w);
+        int y1 = std::min(rects[i].y + std::max(rects[i].height, 0), h);
+        if (x1 <= x0 || y1 <= y0)
+        {
+            continue;
+        }
+        clipped.push_back(Rect{ x0, y0, x1 - x0, y1 - y0 });
+        for (int ty = y0 / DirtyTileSize; ty <= (y1 - 1) / DirtyTileSize; ty++)
+        {
+            for (int tx = x0 / DirtyTileSize; tx <= (x1 - 1) / DirtyTileSize; tx++)
+            {
+                setTile(dirty, ty * grid.m_columns + tx);
+            }
+        }
+        // A tile covered entirely, up to the edge of the image, needs no update.
+        int cx0 = (x0 + DirtyTileSize - 1) / DirtyTileSize;
+        int cy0 = (y0 + DirtyTileSize - 1) / DirtyTileSize;
+        int cx1 = x1 == w ? grid.m_columns : x1 / DirtyTileSize;
+        int cy1 = y1 == h ? grid.m_rows : y1 / DirtyTileSize;
+        for (int ty = cy0; ty < cy1; ty++)
+        {
+            for (int tx = cx0; tx < cx1; tx++)
+            {
+                int index = ty * grid.m_columns + tx;
+                stale[index / 64] &= ~((uint64_t)1 << (index % 64));
+            }
+        }
+    }
+
+    int dest_stride = 0;
+    uint8_t* dest = static_cast<uint8_t*>(acquireImage(&dest_stride));
+    const uint8_t* latest_image = frame->slotData(latest);
+    if (dest_stride < 0)
+    {
+        latest_image += (std::size_t)-dest_stride * (h - 1);
+    }
+    forEachTileRun(stale, grid, w, h, [&](int x, int y, int width, int height)
+    {
+        std::ptrdiff_t offset = (std::ptrdiff_t)dest_stride * y + 3 * x;
+        CopyEngine::copyRows(
+                dest + offset, dest_stride,
+                latest_image + offset, dest_stride,
+                (std::size_t)3 * width, height);
+    });
+    const uint8_t* src = static_cast<const uint8_t*>(image_bits);
+    for (auto& rect : clipped)
+    {
+        CopyEngine::copyRows(
+                dest + (std::ptrdiff_t)dest_stride * rect.y + 3 * rect.x, dest_stride,
+                src + (std::size_t)3 * w * rect.y + 3 * rect.x, (std::ptrdiff_t)3 * w,
+                (std::size_t)3 * rect.width, rect.height);
+    }
+    commitImage(timestamp, dirty.data());
+}
+
+void* FrameBuffer::acquireImage(int* out_stride)
+{
+    if (!m_shmem || m_read_only) return nullptr;
+    auto frame = header();
+
+    // The image is written into the slot next to the latest one,
+    // which receivers are not supposed to be reading now.
+    // The sequence number of the slot stays odd until it is committed.
+    uint32_t slot = (frame->m_latest_slot.load(std::memory_order_relaxed) + 1) % NumImageSlots;
+    auto& image_slot = frame->m_slots[slot];
+    uint32_t sequence = image_slot.m_sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) == 0)
+    {
+        image_slot.m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    // A bottom-up image is exposed from its top row with a negative stride.
+    int stride = 3 * frame->m_width;
+    uint8_t* image = frame->slotData(slot);
+    if (m_image_flags & IMAGE_FLAG_BOTTOM_UP)
+    {
+        image += (std::size_t)stride * (frame->m_height - 1);
+        stride = -stride;
+    }
+    if (out_stride)
+    {
+        *out_stride = stride;
+    }
+    return image;
+}
+
+void FrameBuffer::commitImage()
+{
+    commitImage(Timer::now());
+}
+
+void FrameBuffer::commitImage(uint64_t timestamp)
+{
+    // The whole image may have been rewritten.
+    commitImage(timestamp, nullptr);
+}
+
+// Publishes the acquired slot with the bitmap of the tiles which have changed
+// from the latest image, or with every tile marked if it is null.
+void FrameBuffer::commitImage(uint64_t timestamp, const uint64_t* dirty_tiles)
+{
+    if (!m_shmem || m_read_only) return;
+    auto frame = header();
+
+    uint32_t slot = (frame->m_latest_slot.load(std::memory_order_relaxed) + 1) % NumImageSlots;
+    auto& image_slot = frame->m_slots[slot];
+    uint32_t sequence = image_slot.m_sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) == 0)
+    {
+        // Not acquired
+        return;
+    }
+    uint64_t frame_counter = frame->m_frame_counter.load(std::memory_order_relaxed) + 1;
+    image_slot.m_frame_counter.store(frame_counter, std::memory_order_relaxed);
+    frame->m_slot_timestamps[slot].store(timestamp, std::memory_order_relaxed);
+    if (m_image_flags & IMAGE_FLAG_DIRTY_TILES)
+    {
+        const uint32_t words = TileGrid(frame->m_width, frame->m_height).words();
+        uint64_t* tiles = frame->dirtyTiles(slot, words);
+        if (dirty_tiles)
+        {
+            std::memcpy(tiles, dirty_tiles, sizeof(uint64_t) * words);
+        }
+        else
+        {
+            std::fill_n(tiles, words, ~(uint64_t)0);
+        }
+    }
+    const bool stats = (m_image_flags & IMAGE_FLAG_STATS) != 0;
+    uint64_t commit_time = stats ? Timer::now() : 0;
+    if (stats)
+    {
+        frame->m_sender_stats.m_commit_times[slot].store(commit_time, std::memory_order_relaxed);
+    }
+    image_slot.m_sequence.store(sequence + 1, std::memory_order_release);
+
+    // Publish the new image.
+    // The mutex is needed only for receivers of older versions which read
+    // the image at m_image_offset with the mutex held.
+    std::lock_guard<NamedMutex> lock(m_mutex);
+    if (stats)
+    {
+        uint64_t wait_time = Timer::now() - commit_time;
+        auto& lock_stats = frame->m_lock_stats;
+        lock_stats.m_waits.fetch_add(1, std::memory_order_relaxed);
+        lock_stats.m_wait_time.fetch_add(wait_time, std::memory_order_relaxed);
+        updateMax(lock_stats.m_max_wait_time, wait_time);
+    }
+    frame->m_image_offset = frame->m_slot_offset[slot];
+    frame->m_latest_slot.store(slot, std::memory_order_release);
+    frame->m_frame_counter.store(frame_counter, std::memory_order_release);
+    m_event.notify();
 }
 
-void FrameBuffer::transferToDIB(void* image_bits, uint64_t* out_frame_counter)
+void FrameBuffer::transferToDIB(void* image_bits, uint64_t* out_frame_counter, uint64_t* out_timestamp)
 {
+    uint64_t unused_timestamp = 0;
+    if (!out_timestamp)
+    {
+        out_timestamp = &unused_timestamp;
+    }
+    *out_timestamp = 0;
     if (!m_shmem)
     {
         *out_frame_counter = 0;
         return;
     }
-    std::lock_guard<NamedMutex> lock(m_mutex);
+    auto frame = header();
+    int w = frame->m_width;
+    int h = frame->m_height;
 
+    if (m_legacy_layout)
+    {
+        std::lock_guard<NamedMutex> lock(m_mutex);
+        copyImageToDIB(image_bits, frame->imageData(), w, h);
+        *out_frame_counter = frame->m_frame_counter;
+        return;
+    }
+
+    // Copy the latest image without taking the mutex, and retry if
+    // the sender has overwritten the slot in the meantime.
+    // If the sender has already come round to writing the slot we are
+    // about to read, the image before it is taken instead, which the
+    // sender doesn't write while it writes that slot.
+    // A bottom-up image is already a DIB and is copied at once.
+    const bool bottom_up = (m_image_flags & IMAGE_FLAG_BOTTOM_UP) != 0;
+    const bool has_timestamps = (m_image_flags & IMAGE_FLAG_TIMESTAMPS) != 0;
+    const bool stats = (m_image_flags & IMAGE_FLAG_STATS) != 0;
+    for (int retries = 0; ; backOff(&retries))
+    {
+        uint32_t slot = frame->m_latest_slot.load(std::memory_order_acquire) % NumImageSlots;
+        uint32_t sequence = frame->m_slots[slot].m_sequence.load(std::memory_order_acquire);
+        if (sequence & 1)
+        {
+            slot = (slot + NumImageSlots - 1) % NumImageSlots;
+            sequence = frame->m_slots[slot].m_sequence.load(std::memory_order_acquire);
+            if (sequence & 1)
+            {
+                continue;
+            }
+        }
+        auto& image_slot = frame->m_slots[slot];
+        if (bottom_up)
+        {
+            std::memcpy(image_bits, frame->slotData(slot), (std::size_t)3 * w * h);
+        }
+        else
+        {
+            copyImageToDIB(image_bits, frame->slotData(slot), w, h);
+        }
+        uint64_t frame_counter = image_slot.m_frame_counter.load(std::memory_order_relaxed);
+        uint64_t timestamp = has_timestamps ?
+                frame->m_slot_timestamps[slot].load(std::memory_order_relaxed) : 0;
+        uint64_t commit_time = stats ?
+                frame->m_sender_stats.m_commit_times[slot].load(std::memory_order_relaxed) : 0;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence == image_slot.m_sequence.load(std::memory_order_relaxed))
+        {
+            *out_frame_counter = frame_counter;
+            *out_timestamp = timestamp;
+            if (stats)
+            {
+                recordRead(frame_counter, commit_time);
+            }
+            return;
+        }
+    }
+}
+
+// Brings a DIB holding the image of the frame *inout_frame_counter up to
+// date by copying only the tiles which have changed since that frame.
+// The whole image is copied instead if the DIB holds no frame yet, or if
+// the bitmaps of the frames in between are no longer available.
+void FrameBuffer::refreshDIB(void* image_bits, uint64_t* inout_frame_counter, uint64_t* out_timestamp)
+{
+    uint64_t unused_timestamp = 0;
+    if (!out_timestamp)
+    {
+        out_timestamp = &unused_timestamp;
+    }
+    const uint64_t last_counter = *inout_frame_counter;
+    if (!m_shmem || m_legacy_layout || !(m_image_flags & IMAGE_FLAG_DIRTY_TILES) || last_counter == 0)
+    {
+        transferToDIB(image_bits, inout_frame_counter, out_timestamp);
+        return;
+    }
     auto frame = header();
+    const int w = frame->m_width;
+    const int h = frame->m_height;
+    const TileGrid grid(w, h);
+    const uint32_t words = grid.words();
+    const bool bottom_up = (m_image_flags & IMAGE_FLAG_BOTTOM_UP) != 0;
+    const bool has_timestamps = (m_image_flags & IMAGE_FLAG_TIMESTAMPS) != 0;
+    const bool stats = (m_image_flags & IMAGE_FLAG_STATS) != 0;
+    const std::ptrdiff_t stride = bottom_up ? -3 * w : 3 * w;
+    const std::ptrdiff_t dib_stride = (3 * w + 3) & ~3;
+    uint8_t* dib_top = static_cast<uint8_t*>(image_bits) + dib_stride * (h - 1);
+    std::vector<uint64_t> tiles(words);
+    for (int retries = 0; ; backOff(&retries))
     {
-        int w = frame->m_width;
-        int h = frame->m_height;
-        int gap = ((w * 3 + 3) & ~3) - w * 3;
-        const std::uint8_t* image = frame->imageData();
-        std::uint8_t* dest = (std::uint8_t*)image_bits;
-        for (int y = 0; y < h; y++)
+        // The frames after the last one are in the latest slot and the slots
+        // before it, as long as they have not been overwritten.
+        uint32_t latest = frame->m_latest_slot.load(std::memory_order_acquire) % NumImageSlots;
+        uint32_t sequences[NumImageSlots];
+        uint32_t slots[NumImageSlots];
+        uint32_t num_slots = 0;
+        sequences[0] = frame->m_slots[latest].m_sequence.load(std::memory_order_acquire);
+        if (sequences[0] & 1)
         {
-            const std::uint8_t* src = image + 3 * w * (h - 1 - y);
-            std::memcpy(dest, src, 3 * (uint32_t)w);
-            dest += 3 * w + gap;
+            // The sender is already writing the slot; take whatever image
+            // is stable instead of waiting for it.
+            transferToDIB(image_bits, inout_frame_counter, out_timestamp);
+            return;
+        }
+        uint64_t frame_counter = frame->m_slots[latest].m_frame_counter.load(std::memory_order_relaxed);
+        if (frame_counter < last_counter || NumImageSlots < frame_counter - last_counter)
+        {
+            transferToDIB(image_bits, inout_frame_counter, out_timestamp);
+            return;
+        }
+        std::fill(tiles.begin(), tiles.end(), 0);
+        bool complete = true;
+        for (uint64_t counter = frame_counter; last_counter < counter; counter--)
+        {
+            uint32_t slot = (latest + NumImageSlots - num_slots) % NumImageSlots;
+            uint32_t sequence = num_slots == 0 ? sequences[0] :
+                    frame->m_slots[slot].m_sequence.load(std::memory_order_acquire);
+            if ((sequence & 1) ||
+                frame->m_slots[slot].m_frame_counter.load(std::memory_order_relaxed) != counter)
+            {
+                complete = false;
+                break;
+            }
+            const uint64_t* slot_tiles = frame->dirtyTiles(slot, words);
+            for (uint32_t j = 0; j < words; j++)
+            {
+                tiles[j] |= slot_tiles[j];
+            }
+            sequences[num_slots] = sequence;
+            slots[num_slots] = slot;
+            num_slots += 1;
+        }
+        if (!complete)
+        {
+            transferToDIB(image_bits, inout_frame_counter, out_timestamp);
+            return;
+        }
+        const uint8_t* image_top = frame->slotData(latest) + (bottom_up ? -stride * (h - 1) : 0);
+        forEachTileRun(tiles, grid, w, h, [&](int x, int y, int width, int height)
+        {
+            CopyEngine::copyRows(
+                    dib_top - dib_stride * y + 3 * x, -dib_stride,
+                    image_top + stride * y + 3 * x, stride,
+                    (std::size_t)3 * width, height);
+        });
+        uint64_t timestamp = has_timestamps ?
+                frame->m_slot_timestamps[latest].load(std::memory_order_relaxed) : 0;
+        uint64_t commit_time = stats ?
+                frame->m_sender_stats.m_commit_times[latest].load(std::memory_order_relaxed) : 0;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        bool unchanged = sequences[0] == frame->m_slots[latest].m_sequence.load(std::memory_order_relaxed);
+        for (uint32_t i = 1; i < num_slots; i++)
+        {
+            unchanged = unchanged &&
+                    sequences[i] == frame->m_slots[slots[i]].m_sequence.load(std::memory_order_relaxed);
+        }
+        if (unchanged)
+        {
+            *inout_frame_counter = frame_counter;
+            *out_timestamp = timestamp;
+            if (stats)
+            {
+                recordRead(frame_counter, commit_time);
+            }
+            return;
         }
-        *out_frame_counter = frame->m_frame_counter;
     }
 }
 
@@ -266,24 +1311,67 @@ bool FrameBuffer::waitForNewFrame(uint64_t frame_counter, float time_out)
     Timer timer;
     while (active() && m_sender_watchdog.alive())
     {
+        // Take the event sequence before checking the counter
+        // so that a frame written in between wakes us up.
+        uint32_t sequence = m_event.sequence();
         if (frameCounter() > frame_counter)
         {
             return true;
         }
-        Timer::sleep(0.001f);
-        if (0.0f < time_out && time_out <= timer.get())
+        // The sender may terminate without deactivating the frame buffer,
+        // so the wait is split to check the watchdog regularly.
+        float wait_time = WATCHDOG_MONITOR_INTERVAL;
+        if (0.0f < time_out)
         {
-            return true;
+            float remaining = time_out - timer.get();
+            if (remaining <= 0.0f)
+            {
+                return true;
+            }
+            wait_time = std::min(wait_time, remaining);
+        }
+        if (!m_event.wait(sequence, wait_time) && !senderProcessAlive())
+        {
+            return false;
         }
     }
     return false;
 }
 
+bool FrameBuffer::waitForConnection(float time_out)
+{
+    if (!m_shmem) return false;
+    Timer timer;
+    for (;;)
+    {
+        uint32_t sequence = m_event.sequence();
+        if (connected())
+        {
+            return true;
+        }
+        // Receivers of older versions don't notify us when they connect.
+        float wait_time = WATCHDOG_MONITOR_INTERVAL;
+        if (0.0f < time_out)
+        {
+            float remaining = time_out - timer.get();
+            if (remaining <= 0.0f)
+            {
+                return false;
+            }
+            wait_time = std::min(wait_time, remaining);
+        }
+        m_event.wait(sequence, wait_time);
+    }
+}
+
 void FrameBuffer::release()
 {
     m_receiver_watchdog.stop();
     m_sender_watchdog.stop();
+    m_receiver_slot.reset();
+    m_receivers_gone.reset();
     m_shmem = SharedMemory{};
+    m_registration.reset();
 }
 
 FrameBuffer::Header* FrameBuffer::header()
@@ -296,6 +1384,170 @@ const FrameBuffer::Header* FrameBuffer::header() const
     return static_cast<const Header*>(m_shmem.get());
 }
 
+bool FrameBuffer::stats(Stats* out_stats) const
+{
+    if (!m_shmem || !(m_image_flags & IMAGE_FLAG_STATS) || !out_stats)
+    {
+        return false;
+    }
+    auto frame = header();
+    auto& sender = frame->m_sender_stats;
+    auto& lock = frame->m_lock_stats;
+    *out_stats = Stats{};
+    out_stats->m_frames_written = frame->m_frame_counter.load(std::memory_order_relaxed);
+    out_stats->m_paced_frames = sender.m_paced_frames.load(std::memory_order_relaxed);
+    out_stats->m_late_frames = sender.m_late_frames.load(std::memory_order_relaxed);
+    out_stats->m_oversleep = sender.m_oversleep.load(std::memory_order_relaxed);
+    out_stats->m_max_oversleep = sender.m_max_oversleep.load(std::memory_order_relaxed);
+    out_stats->m_undersleep = sender.m_undersleep.load(std::memory_order_relaxed);
+    out_stats->m_unchanged_frames = sender.m_unchanged_frames.load(std::memory_order_relaxed);
+    out_stats->m_jitter_p50 = sender.m_jitter_p50.load(std::memory_order_relaxed);
+    out_stats->m_jitter_p99 = sender.m_jitter_p99.load(std::memory_order_relaxed);
+    out_stats->m_mutex_waits = lock.m_waits.load(std::memory_order_relaxed);
+    out_stats->m_mutex_wait_time = lock.m_wait_time.load(std::memory_order_relaxed);
+    out_stats->m_max_mutex_wait_time = lock.m_max_wait_time.load(std::memory_order_relaxed);
+    out_stats->m_sender_process_id = frame->m_sender_process_id;
+    out_stats->m_sender_start_time = frame->m_sender_start_time;
+    out_stats->m_sender_heartbeat = frame->m_watchdog_sender_heartbeat.load(std::memory_order_relaxed);
+    out_stats->m_receiver_heartbeat = frame->m_watchdog_receiver_heartbeat.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < NumReceiverSlots; i++)
+    {
+        auto& slot = frame->m_receivers[i];
+        auto& stats = frame->m_receiver_stats[i];
+        auto& out = out_stats->m_receivers[i];
+        out.m_in_use = (slot.m_claim.load(std::memory_order_acquire) & 1) != 0;
+        out.m_process_id = slot.m_process_id.load(std::memory_order_relaxed);
+        out.m_start_time = slot.m_start_time.load(std::memory_order_relaxed);
+        out.m_heartbeat = slot.m_heartbeat.load(std::memory_order_relaxed);
+        out.m_frames_read = stats.m_frames_read.load(std::memory_order_relaxed);
+        out.m_frames_skipped = stats.m_frames_skipped.load(std::memory_order_relaxed);
+        out.m_frame_counter = stats.m_frame_counter.load(std::memory_order_relaxed);
+        out.m_latency = stats.m_latency.load(std::memory_order_relaxed);
+        for (uint32_t j = 0; j < NumLatencyBuckets; j++)
+        {
+            out.m_latency_histogram[j] = stats.m_latency_histogram[j].load(std::memory_order_relaxed);
+        }
+    }
+    return true;
+}
+
+// Records how the sender's pacer released the latest frame: how far from
+// the deadline it woke up if it slept, or whether the frame was late.
+void FrameBuffer::recordPacing(bool slept, int64_t error)
+{
+    if (!m_shmem || m_read_only || !(m_image_flags & IMAGE_FLAG_STATS)) return;
+    auto& stats = header()->m_sender_stats;
+    if (slept)
+    {
+        stats.m_paced_frames.fetch_add(1, std::memory_order_relaxed);
+        if (0 <= error)
+        {
+            stats.m_oversleep.fetch_add((uint64_t)error, std::memory_order_relaxed);
+            updateMax(stats.m_max_oversleep, (uint64_t)error);
+        }
+        else
+        {
+            stats.m_undersleep.fetch_add((uint64_t)-error, std::memory_order_relaxed);
+        }
+    }
+    else if (0 < error)
+    {
+        stats.m_late_frames.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Publishes the percentiles of the jitter the sender's pacer has achieved
+// over the recent frames, in nanoseconds.
+void FrameBuffer::recordJitter(uint64_t p50, uint64_t p99)
+{
+    if (!m_shmem || m_read_only || !(m_image_flags & IMAGE_FLAG_STATS)) return;
+    auto& stats = header()->m_sender_stats;
+    stats.m_jitter_p50.store(p50, std::memory_order_relaxed);
+    stats.m_jitter_p99.store(p99, std::memory_order_relaxed);
+}
+
+// Records that the sender didn't write a frame which was the same as
+// the latest one.
+void FrameBuffer::recordUnchangedFrame()
+{
+    if (!m_shmem || m_read_only || !(m_image_flags & IMAGE_FLAG_STATS)) return;
+    header()->m_sender_stats.m_unchanged_frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameBuffer::recordRead(uint64_t frame_counter, uint64_t commit_time)
+{
+    // Only receivers holding a slot keep statistics.
+    auto slot = static_cast<Header::ReceiverSlot*>(m_receiver_slot.get());
+    if (!slot || slot->m_claim.load(std::memory_order_relaxed) != m_receiver_claim)
+    {
+        return;
+    }
+    auto frame = header();
+    auto& stats = frame->m_receiver_stats[slot - frame->m_receivers];
+    uint64_t last = stats.m_frame_counter.load(std::memory_order_relaxed);
+    if (frame_counter == last)
+    {
+        return;
+    }
+    stats.m_frame_counter.store(frame_counter, std::memory_order_relaxed);
+    stats.m_frames_read.fetch_add(1, std::memory_order_relaxed);
+    if (last != 0 && last + 1 < frame_counter)
+    {
+        stats.m_frames_skipped.fetch_add(frame_counter - last - 1, std::memory_order_relaxed);
+    }
+    uint64_t now = Timer::now();
+    if (commit_time != 0 && commit_time <= now)
+    {
+        uint64_t latency = now - commit_time;
+        stats.m_latency.fetch_add(latency, std::memory_order_relaxed);
+        stats.m_latency_histogram[latencyBucket(latency)].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool FrameBuffer::anyReceiverSlotInUse() const
+{
+    for (auto& receiver : header()->m_receivers)
+    {
+        if (receiver.m_claim.load(std::memory_order_relaxed) & 1)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameBuffer::senderProcessAlive() const
+{
+    auto frame = header();
+    if (m_legacy_layout || frame->m_layout_magic != LayoutMagicV4)
+    {
+        return true;
+    }
+    return Process::isAlive(frame->m_sender_process_id, frame->m_sender_start_time);
+}
+
+// A sender which has terminated abnormally leaves the shared memory behind
+// on POSIX systems, where it would prevent creating the frame buffer again.
+bool FrameBuffer::removeAbandoned(const char* shmem_name, NamedMutex& mutex)
+{
+    std::lock_guard<NamedMutex> lock(mutex);
+
+    auto shmem = SharedMemory::open(shmem_name);
+    if (!shmem || shmem.size() < sizeof(Header))
+    {
+        return false;
+    }
+    auto frame = static_cast<const Header*>(shmem.get());
+    if (frame->m_image_offset < offsetof(Header, m_image_flags) ||
+        frame->m_layout_magic != LayoutMagicV4 ||
+        Process::isAlive(frame->m_sender_process_id, frame->m_sender_start_time))
+    {
+        return false;
+    }
+    SharedMemory::unlink(shmem_name);
+    return true;
+}
+
 bool FrameBuffer::checkDimensions(
                         int width,
                         int height)
@@ -312,13 +1564,34 @@ bool FrameBuffer::checkDimensions(
     return true;
 }
 
+// The size of the header followed by the bitmaps of the dirty tiles,
+// rounded up to a page.
+uint32_t FrameBuffer::calcHeaderSize(
+                        uint16_t width,
+                        uint16_t height)
+{
+    uint32_t bitmaps_size = (uint32_t)sizeof(uint64_t) * TileGrid(width, height).words() * NumImageSlots;
+    return alignUp(alignUp((uint32_t)sizeof(Header), CacheLineSize) + bitmaps_size, ImageAlignment);
+}
+
 uint32_t FrameBuffer::calcMemorySize(
                         uint16_t width,
                         uint16_t height)
 {
-    uint32_t header_size = sizeof(Header);
-    uint32_t image_size = (uint32_t)width * height * 3;
-    uint32_t shmem_size = header_size + image_size;
+    // The first part of the header must be kept compatible with older
+    // versions since the sender and the receivers can be different versions.
+    static_assert(offsetof(Header, m_layout_magic) == LegacyHeaderSize,
+                  "The layout of the header is incompatible with older versions");
+    static_assert(std::atomic<uint8_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+                  "Atomics in shared memory must be lock-free");
+
+    // Each image slot starts at a page boundary so that SIMD and
+    // non-temporal stores on the image are aligned.
+    uint32_t header_size = calcHeaderSize(width, height);
+    uint32_t slot_size = alignUp((uint32_t)width * height * 3, ImageAlignment);
+    uint32_t shmem_size = header_size + slot_size * NumImageSlots;
     return shmem_size;
 }
 
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <atomic>
 #include "Misc.h"
 #include "Watchdog.h"
 
@@ -10,6 +11,7 @@ namespace softcam {
 
 
 using std::uint64_t;
+using std::int64_t;
 using std::uint32_t;
 using std::uint16_t;
 
@@ -18,11 +20,67 @@ using std::uint16_t;
 class FrameBuffer
 {
  public:
+    static constexpr int NUM_RECEIVER_SLOTS = 16;
+    static constexpr int NUM_LATENCY_BUCKETS = 20;
+    static constexpr int DIRTY_TILE_SIZE = 64;
+
+    /// Rectangle in an image in pixels, from the top-left corner
+    struct Rect
+    {
+        int     x;
+        int     y;
+        int     width;
+        int     height;
+    };
+
+    /// Snapshot of the statistics kept in the shared memory
+    ///
+    /// Times are in nanoseconds. Bucket 0 of the latency histogram counts
+    /// latencies below 1 microsecond, bucket i those below 2^i microseconds
+    /// and the last bucket all the rest.
+    /// The heartbeats are counters which keep changing while the peers are
+    /// alive.
+    struct Stats
+    {
+        struct Receiver
+        {
+            bool        m_in_use;
+            uint32_t    m_process_id;
+            uint64_t    m_start_time;
+            uint32_t    m_heartbeat;
+            uint64_t    m_frames_read;
+            uint64_t    m_frames_skipped;
+            uint64_t    m_frame_counter;
+            uint64_t    m_latency;
+            uint32_t    m_latency_histogram[NUM_LATENCY_BUCKETS];
+        };
+        uint64_t    m_frames_written;
+        uint64_t    m_paced_frames;
+        uint64_t    m_late_frames;
+        uint64_t    m_oversleep;
+        uint64_t    m_max_oversleep;
+        uint64_t    m_undersleep;
+        uint64_t    m_unchanged_frames;
+        uint64_t    m_jitter_p50;
+        uint64_t    m_jitter_p99;
+        uint64_t    m_mutex_waits;
+        uint64_t    m_mutex_wait_time;
+        uint64_t    m_max_mutex_wait_time;
+        uint32_t    m_sender_process_id;
+        uint64_t    m_sender_start_time;
+        uint32_t    m_sender_heartbeat;
+        uint32_t    m_receiver_heartbeat;
+        Receiver    m_receivers[NUM_RECEIVER_SLOTS];
+    };
+
     static FrameBuffer create(
                         int             width,
                         int             height,
-                        float           framerate = 0.0f);
-    static FrameBuffer open();
+                        float           framerate = 0.0f,
+                        const char*     name = nullptr,
+                        bool            bottom_up = false);
+    static FrameBuffer open(const char* name = nullptr);
+    static FrameBuffer observe(const char* name = nullptr);
 
     FrameBuffer& operator =(const FrameBuffer&);
     explicit operator bool() const { return handle() != nullptr; }
@@ -31,14 +89,39 @@ class FrameBuffer
     int             width() const;
     int             height() const;
     float           framerate() const;
+    bool            bottomUp() const;
+    bool            hasTimestamps() const;
     uint64_t        frameCounter() const;
     bool            active() const;
     bool            connected() const;
+    bool            readOnly() const { return m_read_only; }
 
     void            deactivate();
     void            write(const void* image_bits);
-    void            transferToDIB(void* image_bits, uint64_t* out_frame_counter);
+    void            write(const void* image_bits, uint64_t timestamp);
+    void            write(const void* image_bits, std::ptrdiff_t stride, uint64_t timestamp);
+    void            writeRegions(
+                        const void* image_bits,
+                        const Rect* rects,
+                        int         count,
+                        uint64_t    timestamp);
+    void*           acquireImage(int* out_stride);
+    void            commitImage();
+    void            commitImage(uint64_t timestamp);
+    void            transferToDIB(
+                        void*       image_bits,
+                        uint64_t*   out_frame_counter,
+                        uint64_t*   out_timestamp = nullptr);
+    void            refreshDIB(
+                        void*       image_bits,
+                        uint64_t*   inout_frame_counter,
+                        uint64_t*   out_timestamp = nullptr);
     bool            waitForNewFrame(uint64_t frame_counter, float time_out = 0.5f);
+    bool            waitForConnection(float time_out);
+    bool            stats(Stats* out_stats) const;
+    void            recordPacing(bool slept, int64_t error);
+    void            recordJitter(uint64_t p50, uint64_t p99);
+    void            recordUnchangedFrame();
 
     void            release();
 
@@ -50,18 +133,40 @@ class FrameBuffer
     struct Header;
 
     mutable NamedMutex      m_mutex;
+    NamedEvent              m_event;
     SharedMemory            m_shmem;
     Watchdog                m_sender_watchdog;
     Watchdog                m_receiver_watchdog;
-
-    explicit FrameBuffer(const char* mutex_name) : m_mutex(mutex_name) {}
+    bool                    m_legacy_layout = false;
+    bool                    m_read_only = false;
+    uint32_t                m_image_flags = 0;
+    std::shared_ptr<void>   m_registration;
+    std::shared_ptr<void>   m_receiver_slot;
+    uint32_t                m_receiver_claim = 0;
+    std::shared_ptr<std::atomic<bool>>  m_receivers_gone;
+
+    explicit FrameBuffer(const char* mutex_name, const char* event_name) :
+        m_mutex(mutex_name),
+        m_event(event_name)
+    {}
 
     Header*         header();
     const Header*   header() const;
-
+    bool            checkLayout(bool* out_has_extension);
+    void            commitImage(uint64_t timestamp, const uint64_t* dirty_tiles);
+    void            recordRead(uint64_t frame_counter, uint64_t commit_time);
+    bool            anyReceiverSlotInUse() const;
+    bool            senderProcessAlive() const;
+
+    static bool     removeAbandoned(
+                        const char*     shmem_name,
+                        NamedMutex&     mutex);
     static bool     checkDimensions(
                         int width,
                         int height);
+    static uint32_t calcHeaderSize(
+                        uint16_t width,
+                        uint16_t height);
     static uint32_t calcMemorySize(
                         uint16_t width,
                         uint16_t height);
@@ -0,0 +1,113 @@
+#include "FrameQueue.h"
+
+#include <algorithm>
+#include "CopyEngine.h"
+
+
+namespace softcam {
+
+
+FrameQueue::FrameQueue(
+                std::size_t         frame_size,
+                int                 capacity,
+                OverflowPolicy      policy,
+                Deliver             deliver) :
+    m_frame_size(frame_size),
+    m_capacity((std::size_t)std::max(1, capacity)),
+    m_policy(policy),
+    m_deliver(std::move(deliver))
+{
+    m_thread = std::thread(&FrameQueue::run, this);
+}
+
+FrameQueue::~FrameQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Frames not delivered yet are discarded.
+        m_stopping = true;
+        m_pending.clear();
+        m_changed.notify_all();
+    }
+    m_thread.join();
+}
+
+void FrameQueue::push(const void* image_bits, std::uint64_t timestamp)
+{
+    Buffer buffer;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_policy == OVERFLOW_BLOCK)
+        {
+            m_changed.wait(lock, [this] { return m_pending.size() < m_capacity; });
+        }
+        else if (m_capacity <= m_pending.size())
+        {
+            buffer = std::move(m_pending.front());
+            m_pending.pop_front();
+            m_dropped += 1;
+        }
+        if (buffer.m_image.empty() && !m_free.empty())
+        {
+            buffer = std::move(m_free.back());
+            m_free.pop_back();
+        }
+    }
+    // The copy is made without the lock so that it doesn't delay the
+    // thread taking the next frame.
+    buffer.m_image.resize(m_frame_size);
+    CopyEngine::copy(buffer.m_image.data(), image_bits, m_frame_size);
+    buffer.m_timestamp = timestamp;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.push_back(std::move(buffer));
+    m_changed.notify_all();
+}
+
+// Waits until every queued frame has been delivered.
+void FrameQueue::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this] { return m_pending.empty() && !m_busy; });
+}
+
+// The number of frames queued, including the one being delivered.
+int FrameQueue::depth() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (int)m_pending.size() + (m_busy ? 1 : 0);
+}
+
+std::uint64_t FrameQueue::dropped() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+void FrameQueue::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_changed.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+        if (m_stopping)
+        {
+            break;
+        }
+        Buffer buffer = std::move(m_pending.front());
+        m_pending.pop_front();
+        m_busy = true;
+        m_changed.notify_all();
+
+        lock.unlock();
+        m_deliver(buffer.m_image.data(), buffer.m_timestamp);
+        lock.lock();
+
+        m_free.push_back(std::move(buffer));
+        m_busy = false;
+        m_changed.notify_all();
+    }
+}
+
+
+} //namespace softcam
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+
+namespace softcam {
+
+
+/// Bounded queue of frames delivered by a background thread
+///
+/// push() copies a frame into one of the recycled buffers and returns,
+/// and the thread passes the queued frames with their timestamps to the
+/// deliver function in order. The deliver function is where the frames are paced, so the
+/// caller of push() doesn't sleep until the frame time.
+/// push() is supposed to be called from one thread at a time.
+class FrameQueue
+{
+ public:
+    enum OverflowPolicy
+    {
+        // Discard the oldest queued frame to make room for the new one.
+        OVERFLOW_DROP_OLDEST,
+        // Wait until the thread takes a frame out of the queue.
+        OVERFLOW_BLOCK,
+    };
+    // Takes the image and the timestamp of a frame.
+    using Deliver = std::function<void(const void*, std::uint64_t)>;
+
+    FrameQueue(
+            std::size_t         frame_size,
+            int                 capacity,
+            OverflowPolicy      policy,
+            Deliver             deliver);
+    ~FrameQueue();
+
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator =(const FrameQueue&) = delete;
+
+    void            push(const void* image_bits, std::uint64_t timestamp);
+    void            flush();
+    int             depth() const;
+    std::uint64_t   dropped() const;
+
+ private:
+    struct Buffer
+    {
+        std::vector<unsigned char>  m_image;
+        std::uint64_t               m_timestamp = 0;
+    };
+
+    const std::size_t           m_frame_size;
+    const std::size_t           m_capacity;
+    const OverflowPolicy        m_policy;
+    const Deliver               m_deliver;
+
+    mutable std::mutex          m_mutex;
+    std::condition_variable     m_changed;
+    std::deque<Buffer>          m_pending;
+    std::vector<Buffer>         m_free;
+    bool                        m_busy = false;
+    bool                        m_stopping = false;
+    std::uint64_t               m_dropped = 0;
+    std::thread                 m_thread;
+
+    void            run();
+};
+
+
+} //namespace softcam
@@ -0,0 +1,191 @@
+#include "ImageHash.h"
+
+#include <cstring>
+#include "CopyEngine.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SOFTCAM_X86
+#include <emmintrin.h>
+#endif
+
+#if defined(SOFTCAM_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define TARGET_SSE2
+#endif
+
+
+namespace softcam {
+
+
+namespace {
+
+// Each chunk of 16 bytes, which is two 64-bit lanes, is mixed with keys
+// offset by the position of the chunk, so that moving a part of the image
+// changes the hash. The product of the two halves of each mixed lane is
+// added to the accumulator of the lane along with the other lane as is,
+// as XXH3 does, which SSE2 computes for both lanes at once.
+// The tail of each row shorter than a chunk is padded with zeros.
+const std::uint64_t Key0 = 0x9e3779b97f4a7c15;
+const std::uint64_t Key1 = 0xc2b2ae3d27d4eb4f;
+
+std::uint64_t mix(std::uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+    return h;
+}
+
+std::uint64_t finish(std::uint64_t acc0, std::uint64_t acc1, std::uint64_t size)
+{
+    std::uint64_t h = mix(size ^ Key1);
+    h = mix(h ^ acc0);
+    h = mix(h ^ acc1);
+    return h;
+}
+
+struct ScalarState
+{
+    std::uint64_t   m_acc0 = 0;
+    std::uint64_t   m_acc1 = 0;
+    std::uint64_t   m_position = 0;
+
+    void    update(const std::uint8_t* chunk)
+    {
+        std::uint64_t d0, d1;
+        std::memcpy(&d0, chunk, 8);
+        std::memcpy(&d1, chunk + 8, 8);
+        std::uint64_t k0 = d0 ^ (Key0 + m_position);
+        std::uint64_t k1 = d1 ^ (Key1 + m_position);
+        m_acc0 += (k0 & 0xffffffff) * (k0 >> 32) + d1;
+        m_acc1 += (k1 & 0xffffffff) * (k1 >> 32) + d0;
+        m_position += 1;
+    }
+};
+
+std::uint64_t hashRowsScalar(
+                    const std::uint8_t* data,
+                    std::ptrdiff_t      stride,
+                    std::size_t         row_size,
+                    std::size_t         rows)
+{
+    ScalarState state;
+    for (std::size_t y = 0; y < rows; y++)
+    {
+        const std::uint8_t* p = data + stride * (std::ptrdiff_t)y;
+        for (std::size_t n = row_size / 16; n > 0; n--)
+        {
+            state.update(p);
+            p += 16;
+        }
+        if (row_size % 16)
+        {
+            std::uint8_t tail[16] = {};
+            std::memcpy(tail, p, row_size % 16);
+            state.update(tail);
+        }
+    }
+    return finish(state.m_acc0, state.m_acc1, (std::uint64_t)row_size * rows);
+}
+
+#if defined(SOFTCAM_X86)
+
+TARGET_SSE2
+std::uint64_t hashRowsSSE2(
+                    const std::uint8_t* data,
+                    std::ptrdiff_t      stride,
+                    std::size_t         row_size,
+                    std::size_t         rows)
+{
+    const __m128i one = _mm_set_epi32(0, 1, 0, 1);
+    __m128i keys = _mm_set_epi64x((long long)Key1, (long long)Key0);
+    __m128i acc = _mm_setzero_si128();
+    auto update = [&](__m128i d)
+    {
+        __m128i k = _mm_xor_si128(d, keys);
+        __m128i product = _mm_mul_epu32(k, _mm_srli_epi64(k, 32));
+        __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+        acc = _mm_add_epi64(acc, _mm_add_epi64(product, swapped));
+        keys = _mm_add_epi64(keys, one);
+    };
+    for (std::size_t y = 0; y < rows; y++)
+    {
+        const std::uint8_t* p = data + stride * (std::ptrdiff_t)y;
+        for (std::size_t n = row_size / 16; n > 0; n--)
+        {
+            update(_mm_loadu_si128((const __m128i*)p));
+            p += 16;
+        }
+        if (row_size % 16)
+        {
+            std::uint8_t tail[16] = {};
+            std::memcpy(tail, p, row_size % 16);
+            update(_mm_loadu_si128((const __m128i*)tail));
+        }
+    }
+    std::uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return finish(lanes[0], lanes[1], (std::uint64_t)row_size * rows);
+}
+
+#endif // SOFTCAM_X86
+
+} //namespace
+
+
+std::uint64_t ImageHash::hash(const void* data, std::size_t size)
+{
+    return hashRows(bestMethod(), data, (std::ptrdiff_t)size, size, 1);
+}
+
+std::uint64_t ImageHash::hashRows(
+                        const void*     data,
+                        std::ptrdiff_t  stride,
+                        std::size_t     row_size,
+                        std::size_t     rows)
+{
+    return hashRows(bestMethod(), data, stride, row_size, rows);
+}
+
+std::uint64_t ImageHash::hashRows(
+                        Method          method,
+                        const void*     data,
+                        std::ptrdiff_t  stride,
+                        std::size_t     row_size,
+                        std::size_t     rows)
+{
+    auto p = static_cast<const std::uint8_t*>(data);
+    #if defined(SOFTCAM_X86)
+    if (method == METHOD_SSE2 && isSupported(METHOD_SSE2))
+    {
+        return hashRowsSSE2(p, stride, row_size, rows);
+    }
+    #else
+    (void)method;
+    #endif
+    return hashRowsScalar(p, stride, row_size, rows);
+}
+
+bool ImageHash::isSupported(Method method)
+{
+    switch (method)
+    {
+    case METHOD_SCALAR: return true;
+    case METHOD_SSE2:   return CopyEngine::isSupported(CopyEngine::METHOD_SSE2);
+    }
+    return false;
+}
+
+ImageHash::Method ImageHash::bestMethod()
+{
+    static const Method best =
+        isSupported(METHOD_SSE2) ? METHOD_SSE2 :
+        METHOD_SCALAR;
+    return best;
+}
+
+
+} //namespace softcam
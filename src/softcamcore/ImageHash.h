@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+
+namespace softcam {
+
+
+/// Fast Hash of Frame Images
+///
+/// This is not a cryptographic hash; it is meant to tell quickly whether
+/// an image is the same as the previous one. The SSE2 implementation is
+/// selected at runtime, and every method gives the same value.
+class ImageHash
+{
+ public:
+    enum Method
+    {
+        METHOD_SCALAR,
+        METHOD_SSE2,
+    };
+
+    static std::uint64_t    hash(const void* data, std::size_t size);
+    static std::uint64_t    hashRows(
+                                const void*     data,
+                                std::ptrdiff_t  stride,
+                                std::size_t     row_size,
+                                std::size_t     rows);
+    static std::uint64_t    hashRows(
+                                Method          method,
+                                const void*     data,
+                                std::ptrdiff_t  stride,
+                                std::size_t     row_size,
+                                std::size_t     rows);
+    static bool             isSupported(Method method);
+    static Method           bestMethod();
+};
+
+
+} //namespace softcam
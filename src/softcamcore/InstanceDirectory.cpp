@@ -0,0 +1,199 @@
+#include "InstanceDirectory.h"
+
+#include <cstring>
+#include <mutex> // lock_guard
+
+
+namespace softcam {
+
+
+const char DirectoryMutexName[] = "DirectShow Softcam/Directory/NamedMutex";
+const char DirectorySharedMemoryName[] = "DirectShow Softcam/Directory/SharedMemory";
+const uint32_t DirectoryMagic = 0x72694453;
+
+
+namespace {
+
+enum EntryState : uint32_t
+{
+    ENTRY_EMPTY = 0,
+    ENTRY_USED = 1,
+    ENTRY_REMOVED = 2,
+};
+
+uint32_t hashName(const char* name)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char* p = name; *p; p++)
+    {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    return hash;
+}
+
+} //namespace
+
+
+// The table is an open addressing hash table with linear probing.
+// Removed entries are left as tombstones so that probing for other names
+// doesn't stop at them.
+// The whole table is accessed only while the mutex is held.
+struct InstanceDirectory::Table
+{
+    struct Entry
+    {
+        uint32_t    m_state;
+        uint32_t    m_hash;
+        char        m_name[MAX_NAME_LENGTH + 1];
+    };
+
+    uint32_t    m_magic;
+    uint32_t    m_capacity;
+    uint32_t    m_count;
+    uint32_t    m_reserved;
+    Entry       m_entries[MAX_INSTANCES];
+};
+
+
+InstanceDirectory InstanceDirectory::open()
+{
+    InstanceDirectory dir(DirectoryMutexName);
+
+    dir.m_shmem = SharedMemory::openOrCreate(DirectorySharedMemoryName, sizeof(Table));
+    if (dir.m_shmem)
+    {
+        std::lock_guard<NamedMutex> lock(dir.m_mutex);
+
+        // A newly created table is zero-filled.
+        auto table = dir.table();
+        if (table->m_magic == 0)
+        {
+            table->m_capacity = MAX_INSTANCES;
+            table->m_magic = DirectoryMagic;
+        }
+        if (table->m_magic != DirectoryMagic ||
+            table->m_capacity != MAX_INSTANCES)
+        {
+            dir.m_shmem = {};
+        }
+    }
+    return dir;
+}
+
+bool InstanceDirectory::isValidName(const char* name)
+{
+    if (!name)
+    {
+        return false;
+    }
+    std::size_t len = std::strlen(name);
+    if (len == 0 || MAX_NAME_LENGTH < len)
+    {
+        return false;
+    }
+    return std::strpbrk(name, "/\\") == nullptr;
+}
+
+bool InstanceDirectory::add(const char* name)
+{
+    if (!m_shmem || !isValidName(name)) return false;
+    std::lock_guard<NamedMutex> lock(m_mutex);
+
+    if (0 <= find(name))
+    {
+        // Left by a sender which terminated without removing it.
+        return true;
+    }
+    auto t = table();
+    uint32_t hash = hashName(name);
+    for (uint32_t i = 0; i < t->m_capacity; i++)
+    {
+        auto& entry = t->m_entries[(hash + i) % t->m_capacity];
+        if (entry.m_state != ENTRY_USED)
+        {
+            entry.m_state = ENTRY_USED;
+            entry.m_hash = hash;
+            std::memcpy(entry.m_name, name, std::strlen(name) + 1);
+            t->m_count += 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+void InstanceDirectory::remove(const char* name)
+{
+    if (!m_shmem || !isValidName(name)) return;
+    std::lock_guard<NamedMutex> lock(m_mutex);
+
+    int index = find(name);
+    if (0 <= index)
+    {
+        auto t = table();
+        t->m_entries[index].m_state = ENTRY_REMOVED;
+        t->m_count -= 1;
+    }
+}
+
+bool InstanceDirectory::contains(const char* name) const
+{
+    if (!m_shmem || !isValidName(name)) return false;
+    std::lock_guard<NamedMutex> lock(m_mutex);
+
+    return 0 <= find(name);
+}
+
+std::vector<std::string> InstanceDirectory::list() const
+{
+    std::vector<std::string> names;
+    if (!m_shmem) return names;
+    std::lock_guard<NamedMutex> lock(m_mutex);
+
+    auto t = table();
+    for (uint32_t i = 0; i < t->m_capacity; i++)
+    {
+        auto& entry = t->m_entries[i];
+        if (entry.m_state == ENTRY_USED &&
+            entry.m_name[MAX_NAME_LENGTH] == '\0')
+        {
+            names.emplace_back(entry.m_name);
+        }
+    }
+    return names;
+}
+
+InstanceDirectory::Table* InstanceDirectory::table()
+{
+    return static_cast<Table*>(m_shmem.get());
+}
+
+const InstanceDirectory::Table* InstanceDirectory::table() const
+{
+    return static_cast<const Table*>(m_shmem.get());
+}
+
+int InstanceDirectory::find(const char* name) const
+{
+    auto t = table();
+    uint32_t hash = hashName(name);
+    for (uint32_t i = 0; i < t->m_capacity; i++)
+    {
+        uint32_t index = (hash + i) % t->m_capacity;
+        auto& entry = t->m_entries[index];
+        if (entry.m_state == ENTRY_EMPTY)
+        {
+            break;
+        }
+        if (entry.m_state == ENTRY_USED &&
+            entry.m_hash == hash &&
+            std::strncmp(entry.m_name, name, sizeof(entry.m_name)) == 0)
+        {
+            return (int)index;
+        }
+    }
+    return -1;
+}
+
+
+} //namespace softcam
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Misc.h"
+
+
+namespace softcam {
+
+
+/// Directory of named camera instances shared between processes
+class InstanceDirectory
+{
+ public:
+    static constexpr int MAX_INSTANCES = 64;
+    static constexpr int MAX_NAME_LENGTH = 63;
+
+    static InstanceDirectory open();
+    static bool     isValidName(const char* name);
+
+    explicit operator bool() const { return m_shmem ? true : false; }
+
+    bool            add(const char* name);
+    void            remove(const char* name);
+    bool            contains(const char* name) const;
+    std::vector<std::string> list() const;
+
+ private:
+    struct Table;
+
+    mutable NamedMutex      m_mutex;
+    SharedMemory            m_shmem;
+
+    explicit InstanceDirectory(const char* mutex_name) : m_mutex(mutex_name) {}
+
+    Table*          table();
+    const Table*    table() const;
+    int             find(const char* name) const;
+};
+
+
+} //namespace softcam
@@ -1,13 +1,40 @@
 #include "Misc.h"
 
+#if defined(_WIN32)
 #include <windows.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+#include <string>
+#include <atomic>
+#include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <thread>
 
 
 namespace softcam {
 
 
+#if defined(_WIN32)
+
+
 Timer::Timer()
 {
     QueryPerformanceCounter((LARGE_INTEGER*)&m_clock);
@@ -33,41 +60,115 @@ void Timer::reset()
     QueryPerformanceCounter((LARGE_INTEGER*)&m_clock);
 }
 
+namespace {
+
+#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// The timer objects of the calling thread, which are created on the first
+// sleep of the thread and reused until the thread exits.
+// A high resolution waitable timer is available since Windows 10 1803;
+// otherwise, a multimedia timer signals an event with 1 ms resolution.
+struct ThreadTimer
+{
+    HANDLE  m_waitable_timer;
+    HANDLE  m_event;
+
+    ThreadTimer() :
+        m_waitable_timer(CreateWaitableTimerExW(
+                            nullptr,
+                            nullptr,
+                            CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                            TIMER_ALL_ACCESS)),
+        m_event(m_waitable_timer ? nullptr : CreateEventA(nullptr, false, false, nullptr))
+    {
+    }
+    ~ThreadTimer()
+    {
+        if (m_waitable_timer) CloseHandle(m_waitable_timer);
+        if (m_event) CloseHandle(m_event);
+    }
+};
+
+ThreadTimer& threadTimer()
+{
+    thread_local ThreadTimer timer;
+    return timer;
+}
+
+} //namespace
+
 void Timer::sleep(float seconds)
 {
     if (seconds <= 0.0f)
     {
         return;
     }
+    auto& timer = threadTimer();
+    if (timer.m_waitable_timer)
+    {
+        // in 100 ns units; negative for a relative time
+        LARGE_INTEGER due;
+        due.QuadPart = -std::max<LONGLONG>(1, (LONGLONG)std::round(seconds * 1e7));
+        if (SetWaitableTimer(timer.m_waitable_timer, &due, 0, nullptr, nullptr, false))
+        {
+            WaitForSingleObject(timer.m_waitable_timer, INFINITE);
+            return;
+        }
+    }
     unsigned delay_msec = (unsigned)std::round(seconds * 1000.0f);
     if (delay_msec == 0)
     {
         delay_msec = 1;
     }
-    HANDLE e = CreateEventA(nullptr, false, false, nullptr);
-    if (e == nullptr)
+    if (timer.m_event)
     {
-        // fallback to older API
-        Sleep(delay_msec);
-        return;
+        MMRESULT ret = timeSetEvent(
+                        delay_msec,
+                        1,
+                        (LPTIMECALLBACK)timer.m_event,
+                        0,
+                        TIME_ONESHOT | TIME_CALLBACK_EVENT_SET);
+        if (ret != 0)
+        {
+            WaitForSingleObject(timer.m_event, INFINITE);
+            return;
+        }
     }
-    MMRESULT ret = timeSetEvent(
-                    delay_msec,
-                    1,
-                    (LPTIMECALLBACK)e,
-                    0,
-                    TIME_ONESHOT | TIME_CALLBACK_EVENT_SET);
-    if (ret == 0)
-    {
-        // fallback to older API
-        CloseHandle(e);
-        Sleep(delay_msec);
-        return;
+    // fallback to older API
+    Sleep(delay_msec);
+}
+
+std::uint64_t Timer::now()
+{
+    static const std::uint64_t frequency = []
+    {
+        std::uint64_t f;
+        QueryPerformanceFrequency((LARGE_INTEGER*)&f);
+        return f;
+    }();
+    const std::uint64_t NANOSECONDS_PER_SECOND = 1000000000;
+    std::uint64_t clock;
+    QueryPerformanceCounter((LARGE_INTEGER*)&clock);
+    // Split to avoid overflow of the multiplication.
+    return clock / frequency * NANOSECONDS_PER_SECOND +
+            clock % frequency * NANOSECONDS_PER_SECOND / frequency;
+}
+
+namespace {
+
+void sleepCoarselyUntil(std::uint64_t time)
+{
+    std::uint64_t current = Timer::now();
+    if (current < time)
+    {
+        Timer::sleep((float)((double)(time - current) * 1e-9));
     }
-    WaitForSingleObject(e, INFINITE);
-    CloseHandle(e);
 }
 
+} //namespace
+
 
 NamedMutex::NamedMutex(const char* name) :
     m_handle(CreateMutexA(nullptr, false, name), closeHandle)
@@ -82,6 +183,10 @@ void NamedMutex::lock()
 
 void NamedMutex::unlock()
 {
+    if (!m_handle)
+    {
+        return;
+    }
     bool ret = ReleaseMutex(m_handle.get());
 
     assert( ret == true && "Tried to release a mutex that is not locked" );
@@ -105,6 +210,121 @@ void NamedMutex::closeHandle(void* ptr)
     }
 }
 
+namespace {
+
+struct SharedEvent
+{
+    std::atomic<uint32_t>   m_sequence;
+};
+
+// Waiters for the sequence number s block on m_events[(s + 1) & 1].
+// Each notification resets the event for the next round before publishing
+// a new sequence number, so neither of the manual-reset events stays
+// signaled while a waiter is expected to block on it.
+// A waiter checks the sequence number with m_mutex held and releases it
+// as it starts blocking, since the event it is about to block on is reset
+// again by the second notification after the sequence number it has seen.
+struct EventHandles
+{
+    HANDLE          m_mapping = nullptr;
+    HANDLE          m_mutex = nullptr;
+    HANDLE          m_events[2] = {};
+    SharedEvent*    m_shared = nullptr;
+};
+
+} //namespace
+
+
+// Since Win32 kernel objects of different types share one namespace,
+// each of the objects composing an event has its own suffixed name.
+NamedEvent::NamedEvent(const char* name)
+{
+    auto handles = new EventHandles;
+    m_handle.reset(handles, closeHandle);
+    const std::string base = name;
+    handles->m_mapping = CreateFileMappingA(
+                    INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                    0, sizeof(SharedEvent), base.c_str());
+    if (handles->m_mapping)
+    {
+        handles->m_shared = static_cast<SharedEvent*>(
+                    MapViewOfFile(handles->m_mapping, FILE_MAP_WRITE, 0, 0, 0));
+    }
+    handles->m_mutex = CreateMutexA(nullptr, false, (base + "/Lock").c_str());
+    handles->m_events[0] = CreateEventA(nullptr, true, false, (base + "/0").c_str());
+    handles->m_events[1] = CreateEventA(nullptr, true, false, (base + "/1").c_str());
+
+    assert( handles->m_shared != nullptr && handles->m_mutex != nullptr &&
+            handles->m_events[0] != nullptr && handles->m_events[1] != nullptr &&
+            "Creating a named event failed" );
+}
+
+std::uint32_t NamedEvent::sequence() const
+{
+    auto handles = static_cast<const EventHandles*>(m_handle.get());
+    return handles->m_shared->m_sequence.load();
+}
+
+bool NamedEvent::wait(std::uint32_t sequence, float timeout)
+{
+    auto handles = static_cast<EventHandles*>(m_handle.get());
+    Timer timer;
+    while (handles->m_shared->m_sequence.load() == sequence)
+    {
+        float remaining = timeout - timer.get();
+        if (remaining <= 0.0f)
+        {
+            break;
+        }
+        DWORD msec = (DWORD)std::ceil(remaining * 1000.0f);
+        // WAIT_ABANDONED also gives us the ownership.
+        WaitForSingleObject(handles->m_mutex, INFINITE);
+        if (handles->m_shared->m_sequence.load() != sequence)
+        {
+            ReleaseMutex(handles->m_mutex);
+            break;
+        }
+        SignalObjectAndWait(handles->m_mutex, handles->m_events[(sequence + 1) & 1], msec, false);
+    }
+    return handles->m_shared->m_sequence.load() != sequence;
+}
+
+void NamedEvent::notify()
+{
+    auto handles = static_cast<EventHandles*>(m_handle.get());
+
+    // Notifications from different threads or processes must not interleave,
+    // nor with a waiter about to block. WAIT_ABANDONED also gives us the
+    // ownership.
+    WaitForSingleObject(handles->m_mutex, INFINITE);
+    std::uint32_t next = handles->m_shared->m_sequence.load() + 1;
+    ResetEvent(handles->m_events[(next + 1) & 1]);
+    handles->m_shared->m_sequence.store(next);
+    SetEvent(handles->m_events[next & 1]);
+    ReleaseMutex(handles->m_mutex);
+}
+
+void NamedEvent::closeHandle(void* ptr)
+{
+    if (ptr)
+    {
+        auto handles = static_cast<EventHandles*>(ptr);
+        if (handles->m_shared)
+        {
+            UnmapViewOfFile(handles->m_shared);
+        }
+        for (HANDLE h : { handles->m_mapping, handles->m_mutex,
+                          handles->m_events[0], handles->m_events[1] })
+        {
+            if (h)
+            {
+                CloseHandle(h);
+            }
+        }
+        delete handles;
+    }
+}
+
 SharedMemory
 SharedMemory::create(const char* name, unsigned long size)
 {
@@ -117,6 +337,55 @@ SharedMemory::open(const char* name)
     return SharedMemory(name);
 }
 
+SharedMemory
+SharedMemory::openReadOnly(const char* name)
+{
+    SharedMemory shmem;
+    shmem.m_handle.reset(
+        OpenFileMappingA(FILE_MAP_READ, false, name),
+        closeHandle);
+    if (shmem.m_handle)
+    {
+        shmem.m_address.reset(
+            MapViewOfFile(shmem.m_handle.get(), FILE_MAP_READ, 0, 0, 0),
+            unmap);
+        MEMORY_BASIC_INFORMATION meminfo;
+        if (shmem.m_address &&
+            0 < VirtualQuery(shmem.m_address.get(), &meminfo, sizeof(meminfo)))
+        {
+            shmem.m_size = (unsigned long)meminfo.RegionSize;
+            return shmem;
+        }
+    }
+    shmem.release();
+    return shmem;
+}
+
+SharedMemory
+SharedMemory::openOrCreate(const char* name, unsigned long size)
+{
+    SharedMemory shmem;
+    shmem.m_handle.reset(
+        CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, size, name),
+        closeHandle);
+    if (shmem.m_handle)
+    {
+        shmem.m_address.reset(
+            MapViewOfFile(shmem.m_handle.get(), FILE_MAP_WRITE, 0, 0, 0),
+            unmap);
+        MEMORY_BASIC_INFORMATION meminfo;
+        if (shmem.m_address &&
+            0 < VirtualQuery(shmem.m_address.get(), &meminfo, sizeof(meminfo)) &&
+            size <= meminfo.RegionSize)
+        {
+            shmem.m_size = size;
+            return shmem;
+        }
+    }
+    shmem.release();
+    return shmem;
+}
+
 SharedMemory::SharedMemory(const char* name, unsigned long size)
 {
     m_handle.reset(
@@ -188,4 +457,688 @@ SharedMemory::unmap(void* ptr)
     }
 }
 
+// A file mapping object is destroyed when its last handle is closed,
+// including the handles of terminated processes.
+void
+SharedMemory::unlink(const char* /*name*/)
+{
+}
+
+
+std::uint32_t Process::currentId()
+{
+    return GetCurrentProcessId();
+}
+
+std::uint64_t Process::startTime(std::uint32_t id)
+{
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, id);
+    if (!process)
+    {
+        return 0;
+    }
+    std::uint64_t start_time = 0;
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes(process, &creation, &exit, &kernel, &user))
+    {
+        start_time = ((std::uint64_t)creation.dwHighDateTime << 32) | creation.dwLowDateTime;
+    }
+    CloseHandle(process);
+    return start_time;
+}
+
+bool Process::isAlive(std::uint32_t id, std::uint64_t start_time)
+{
+    if (id == 0)
+    {
+        return true;
+    }
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, id);
+    if (!process)
+    {
+        // No process has the ID, or we are not allowed to open it.
+        return GetLastError() != ERROR_INVALID_PARAMETER;
+    }
+    // A process object stays signaled after termination while someone
+    // holds a handle to it.
+    bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    FILETIME creation, exit, kernel, user;
+    if (alive && start_time != 0 &&
+        GetProcessTimes(process, &creation, &exit, &kernel, &user))
+    {
+        alive = start_time == (((std::uint64_t)creation.dwHighDateTime << 32) | creation.dwLowDateTime);
+    }
+    CloseHandle(process);
+    return alive;
+}
+
+#else // _WIN32
+
+//
+// POSIX implementation
+//
+// Named objects are mapped onto POSIX shared memory objects.
+// Since a name of a POSIX shared memory object must be a single path
+// component, slashes in the given name are replaced with underscores.
+// Backslashes are rejected in the same way as Win32 does for names of
+// kernel objects.
+//
+
+namespace {
+
+const std::uint64_t NANOSECONDS_PER_SECOND = 1000000000;
+
+std::uint64_t monotonicNow()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (std::uint64_t)ts.tv_sec * NANOSECONDS_PER_SECOND + (std::uint64_t)ts.tv_nsec;
+}
+
+std::string toPosixName(const char* name)
+{
+    if (!name || !*name)
+    {
+        return {};
+    }
+    std::string posix_name = "/";
+    for (const char* p = name; *p; p++)
+    {
+        if (*p == '\\')
+        {
+            return {};
+        }
+        posix_name += *p == '/' ? '_' : *p;
+    }
+    return posix_name;
+}
+
+struct SharedMutex
+{
+    pthread_mutex_t         m_mutex;
+    std::atomic<uint32_t>   m_ready;
+};
+
+// Opens a small shared memory object which is never unlinked, or creates it
+// zero-filled if it doesn't exist yet.
+// The openers of the object take turns holding a lock on it, while which
+// the object is extended and `initialize`, if any, is called to initialize
+// the contents unless someone has done so. Since the lock is released when
+// its holder terminates, a process terminating halfway only leaves the
+// object uninitialized for the next opener, which then initializes it.
+void* openPersistentObject(const char* name, std::size_t size, void (*initialize)(void*))
+{
+    const std::string posix_name = toPosixName(name);
+    if (posix_name.empty())
+    {
+        return nullptr;
+    }
+    int fd = shm_open(posix_name.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    int ret;
+    while ((ret = flock(fd, LOCK_EX)) != 0 && errno == EINTR)
+    {
+    }
+    // Some systems don't support locks on shared memory objects,
+    // on which the object is opened without the lock.
+    void* addr = MAP_FAILED;
+    struct stat st;
+    if ((ret == 0 || errno == ENOTSUP || errno == EOPNOTSUPP) &&
+        fstat(fd, &st) == 0 &&
+        ((std::size_t)st.st_size >= size || ftruncate(fd, (off_t)size) == 0))
+    {
+        addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED && initialize)
+        {
+            initialize(addr);
+        }
+    }
+    // The mapping keeps the open file, and thus the lock, alive after the
+    // file descriptor is closed, so the lock is released explicitly.
+    flock(fd, LOCK_UN);
+    close(fd);
+    return addr != MAP_FAILED ? addr : nullptr;
+}
+
+void initializeSharedMutex(void* addr)
+{
+    SharedMutex* shared = static_cast<SharedMutex*>(addr);
+    if (shared->m_ready.load(std::memory_order_acquire) != 0)
+    {
+        return;
+    }
+    // A robust mutex lets the next owner recover the lock even if
+    // the process holding it has terminated abnormally. It is recursive
+    // like a Win32 mutex, and still tells an unlock by a non-owner.
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&shared->m_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    shared->m_ready.store(1, std::memory_order_release);
+}
+
+SharedMutex* openSharedMutex(const char* name)
+{
+    return static_cast<SharedMutex*>(
+            openPersistentObject(name, sizeof(SharedMutex), initializeSharedMutex));
+}
+
+struct SharedEvent
+{
+    std::atomic<uint32_t>   m_sequence;
+    std::atomic<uint32_t>   m_waiters;
+};
+
+} //namespace
+
+
+Timer::Timer() :
+    m_clock(monotonicNow()),
+    m_frequency(NANOSECONDS_PER_SECOND)
+{
+}
+
+float Timer::get()
+{
+    std::uint64_t now = monotonicNow();
+    float elapsed = (float)((double)int64_t(now - m_clock) / (double)m_frequency);
+    return elapsed;
+}
+
+void Timer::rewind(float delta)
+{
+    uint64_t delta_clock = (uint64_t)std::round(delta * (double)m_frequency);
+    m_clock += delta_clock;
+}
+
+void Timer::reset()
+{
+    m_clock = monotonicNow();
+}
+
+void Timer::sleep(float seconds)
+{
+    if (seconds <= 0.0f)
+    {
+        return;
+    }
+    std::uint64_t deadline = monotonicNow() +
+                    (std::uint64_t)std::round(seconds * (double)NANOSECONDS_PER_SECOND);
+    timespec ts;
+    ts.tv_sec = (time_t)(deadline / NANOSECONDS_PER_SECOND);
+    ts.tv_nsec = (long)(deadline % NANOSECONDS_PER_SECOND);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+    {
+    }
+}
+
+std::uint64_t Timer::now()
+{
+    return monotonicNow();
+}
+
+namespace {
+
+void sleepCoarselyUntil(std::uint64_t time)
+{
+    timespec ts;
+    ts.tv_sec = (time_t)(time / NANOSECONDS_PER_SECOND);
+    ts.tv_nsec = (long)(time % NANOSECONDS_PER_SECOND);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+    {
+    }
+}
+
+} //namespace
+
+
+// The mutex object lives in its own small shared memory object which is
+// intentionally never unlinked, so that every process opening the same name
+// at any time shares the same mutex, like a Win32 named mutex does.
+NamedMutex::NamedMutex(const char* name) :
+    m_handle(openSharedMutex(name), closeHandle)
+{
+    assert( m_handle.get() != nullptr && "Creating a named mutex failed" );
+}
+
+// A mutex which has failed to be opened is neither locked nor unlocked,
+// instead of crashing.
+void NamedMutex::lock()
+{
+    auto shared = static_cast<SharedMutex*>(m_handle.get());
+    if (!shared)
+    {
+        return;
+    }
+    int ret = pthread_mutex_lock(&shared->m_mutex);
+    if (ret == EOWNERDEAD)
+    {
+        // The previous owner died while holding the lock.
+        pthread_mutex_consistent(&shared->m_mutex);
+        ret = 0;
+    }
+
+    assert( ret == 0 && "Locking a mutex failed" );
+    (void)ret;
+}
+
+void NamedMutex::unlock()
+{
+    auto shared = static_cast<SharedMutex*>(m_handle.get());
+    if (!shared)
+    {
+        return;
+    }
+    int ret = pthread_mutex_unlock(&shared->m_mutex);
+
+    assert( ret == 0 && "Tried to release a mutex that is not locked" );
+    (void)ret;
+}
+
+void NamedMutex::closeHandle(void* ptr)
+{
+    if (ptr)
+    {
+        #ifndef NDEBUG
+        // checks for the error of closing still owned mutex
+        int ret1 = pthread_mutex_unlock(&static_cast<SharedMutex*>(ptr)->m_mutex);
+        assert( ret1 != 0 && "Tried to delete a mutex that is locked" );
+        #endif
+
+        int ret2 = munmap(ptr, sizeof(SharedMutex));
+
+        assert( ret2 == 0 && "munmap() for a mutex failed" );
+        (void)ret2;
+    }
+}
+
+
+// The sequence number lives in a never unlinked shared memory object as well
+// as the mutex does. On Linux, waiters sleep on it with a futex.
+NamedEvent::NamedEvent(const char* name) :
+    m_handle(
+        openPersistentObject(name, sizeof(SharedEvent), nullptr),
+        closeHandle)
+{
+    assert( m_handle.get() != nullptr && "Creating a named event failed" );
+}
+
+std::uint32_t NamedEvent::sequence() const
+{
+    auto shared = static_cast<const SharedEvent*>(m_handle.get());
+    return shared->m_sequence.load();
+}
+
+bool NamedEvent::wait(std::uint32_t sequence, float timeout)
+{
+    auto shared = static_cast<SharedEvent*>(m_handle.get());
+    Timer timer;
+    shared->m_waiters.fetch_add(1);
+    while (shared->m_sequence.load() == sequence)
+    {
+        float remaining = timeout - timer.get();
+        if (remaining <= 0.0f)
+        {
+            break;
+        }
+        #if defined(__linux__)
+        std::uint64_t nsec = (std::uint64_t)std::ceil(remaining * (double)NANOSECONDS_PER_SECOND);
+        timespec ts;
+        ts.tv_sec = (time_t)(nsec / NANOSECONDS_PER_SECOND);
+        ts.tv_nsec = (long)(nsec % NANOSECONDS_PER_SECOND);
+        syscall(SYS_futex, &shared->m_sequence, FUTEX_WAIT, sequence, &ts, nullptr, 0);
+        #else
+        Timer::sleep(std::min(remaining, 0.001f));
+        #endif
+    }
+    shared->m_waiters.fetch_sub(1);
+    return shared->m_sequence.load() != sequence;
+}
+
+void NamedEvent::notify()
+{
+    auto shared = static_cast<SharedEvent*>(m_handle.get());
+    shared->m_sequence.fetch_add(1);
+    #if defined(__linux__)
+    if (shared->m_waiters.load() != 0)
+    {
+        syscall(SYS_futex, &shared->m_sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+    #endif
+}
+
+void NamedEvent::closeHandle(void* ptr)
+{
+    if (ptr)
+    {
+        int ret = munmap(ptr, sizeof(SharedEvent));
+
+        assert( ret == 0 && "munmap() for an event failed" );
+        (void)ret;
+    }
+}
+
+SharedMemory
+SharedMemory::create(const char* name, unsigned long size)
+{
+    return SharedMemory(name, size);
+}
+
+SharedMemory
+SharedMemory::open(const char* name)
+{
+    return SharedMemory(name);
+}
+
+// The mapping is not writable, and the object is not unlinked on release
+// as the caller doesn't own it.
+SharedMemory
+SharedMemory::openReadOnly(const char* name)
+{
+    SharedMemory shmem;
+    const std::string posix_name = toPosixName(name);
+    if (posix_name.empty())
+    {
+        return shmem;
+    }
+    int fd = shm_open(posix_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return shmem;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && 0 < st.st_size)
+    {
+        unsigned long size = (unsigned long)st.st_size;
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            shmem.m_address.reset(addr, [size](void* ptr) { munmap(ptr, size); });
+            shmem.m_size = size;
+        }
+    }
+    close(fd);
+    return shmem;
+}
+
+// Unlike create(), the object is never unlinked, so that every process
+// opening the same name at any time shares the same memory.
+SharedMemory
+SharedMemory::openOrCreate(const char* name, unsigned long size)
+{
+    SharedMemory shmem;
+    void* addr = size == 0 ? nullptr : openPersistentObject(name, size, nullptr);
+    if (addr)
+    {
+        shmem.m_address.reset(addr, [size](void* ptr) { munmap(ptr, size); });
+        shmem.m_size = size;
+    }
+    return shmem;
+}
+
+// The creator owns the name of the shared memory object and unlinks it when
+// the last copy of the creator's SharedMemory instance is released.
+// Mappings already opened by other instances stay valid after that, though
+// opening the name again fails as the object no longer exists.
+SharedMemory::SharedMemory(const char* name, unsigned long size)
+{
+    const std::string posix_name = toPosixName(name);
+    if (posix_name.empty() || size == 0)
+    {
+        return;
+    }
+    int fd = shm_open(posix_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        return;
+    }
+    m_handle.reset(new std::string(posix_name), closeHandle);
+    if (ftruncate(fd, (off_t)size) == 0)
+    {
+        void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            close(fd);
+            m_address.reset(addr, [size](void* ptr) { munmap(ptr, size); });
+            m_size = size;
+            return;
+        }
+    }
+    close(fd);
+    release();
+}
+
+SharedMemory::SharedMemory(const char* name)
+{
+    const std::string posix_name = toPosixName(name);
+    if (posix_name.empty())
+    {
+        return;
+    }
+    int fd = shm_open(posix_name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && 0 < st.st_size)
+    {
+        unsigned long size = (unsigned long)st.st_size;
+        void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            close(fd);
+            m_address.reset(addr, [size](void* ptr) { munmap(ptr, size); });
+            m_size = size;
+            return;
+        }
+    }
+    close(fd);
+    release();
+}
+
+void
+SharedMemory::release()
+{
+    m_size = 0;
+    m_address.reset();
+    m_handle.reset();
+}
+
+void
+SharedMemory::closeHandle(void* ptr)
+{
+    if (ptr)
+    {
+        std::string* posix_name = static_cast<std::string*>(ptr);
+        shm_unlink(posix_name->c_str());
+        delete posix_name;
+    }
+}
+
+// Removes the name of an object left by a process which terminated without
+// releasing it, so that the name can be created again.
+void
+SharedMemory::unlink(const char* name)
+{
+    const std::string posix_name = toPosixName(name);
+    if (!posix_name.empty())
+    {
+        shm_unlink(posix_name.c_str());
+    }
+}
+
+
+std::uint32_t Process::currentId()
+{
+    return (std::uint32_t)getpid();
+}
+
+#if defined(__linux__)
+
+namespace {
+
+// Reads the state and the start time (in clock ticks since boot) of
+// a process from /proc/<id>/stat.
+// Returns false if the process doesn't exist.
+bool readProcessStat(std::uint32_t id, char* out_state, std::uint64_t* out_start_time)
+{
+    *out_state = '?';
+    *out_start_time = 0;
+    char path[32];
+    std::snprintf(path, sizeof(path), "/proc/%u/stat", (unsigned)id);
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return errno != ENOENT;
+    }
+    char buf[512];
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+    {
+        return len == 0 ? false : errno != ESRCH;
+    }
+    buf[len] = '\0';
+
+    // The command name in parentheses may contain spaces and parentheses.
+    const char* p = std::strrchr(buf, ')');
+    if (!p || p[1] != ' ' || !p[2])
+    {
+        return true;
+    }
+    p += 2;
+    *out_state = *p;
+    // The start time is the 20th field after the state.
+    for (int i = 0; i < 19 && p; i++)
+    {
+        p = std::strchr(p + 1, ' ');
+    }
+    if (p)
+    {
+        *out_start_time = std::strtoull(p + 1, nullptr, 10);
+    }
+    return true;
+}
+
+} //namespace
+
+std::uint64_t Process::startTime(std::uint32_t id)
+{
+    char state;
+    std::uint64_t start_time;
+    readProcessStat(id, &state, &start_time);
+    return start_time;
+}
+
+bool Process::isAlive(std::uint32_t id, std::uint64_t start_time)
+{
+    if (id == 0)
+    {
+        return true;
+    }
+    char state;
+    std::uint64_t actual_start_time;
+    if (!readProcessStat(id, &state, &actual_start_time))
+    {
+        return false;
+    }
+    // A terminated process stays as a zombie until its parent reaps it.
+    if (state == 'Z' || state == 'X')
+    {
+        return false;
+    }
+    return start_time == 0 || actual_start_time == 0 || start_time == actual_start_time;
+}
+
+#else // __linux__
+
+std::uint64_t Process::startTime(std::uint32_t /*id*/)
+{
+    return 0;
+}
+
+bool Process::isAlive(std::uint32_t id, std::uint64_t /*start_time*/)
+{
+    if (id == 0)
+    {
+        return true;
+    }
+    return kill((pid_t)id, 0) == 0 || errno != ESRCH;
+}
+
+#endif // __linux__
+
+#endif // _WIN32
+
+
+//
+// Common implementation
+//
+
+namespace {
+
+// The margin before the deadline where the coarse sleep ends and the spin
+// begins. It follows how late the coarse sleeps of the thread wake up,
+// growing quickly and shrinking slowly.
+const std::uint64_t MIN_SPIN_MARGIN = 20000;        // 20 us
+const std::uint64_t MAX_SPIN_MARGIN = 2000000;      // 2 ms
+const std::uint64_t YIELD_THRESHOLD = 100000;       // 100 us
+
+void cpuRelax()
+{
+    #if defined(_WIN32)
+    YieldProcessor();
+    #elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+    #endif
+}
+
+} //namespace
+
+void Timer::sleepUntil(std::uint64_t time)
+{
+    thread_local std::uint64_t margin = MIN_SPIN_MARGIN * 4;
+
+    std::uint64_t current = now();
+    if (time <= current)
+    {
+        return;
+    }
+    if (margin < time - current)
+    {
+        std::uint64_t target = time - margin;
+        sleepCoarselyUntil(target);
+        current = now();
+        std::uint64_t overshoot = target < current ? current - target : 0;
+        if (margin < overshoot)
+        {
+            margin += (overshoot - margin) / 2;
+        }
+        else
+        {
+            margin -= (margin - overshoot) / 16;
+        }
+        margin = std::min(std::max(margin, MIN_SPIN_MARGIN), MAX_SPIN_MARGIN);
+    }
+    while (current < time)
+    {
+        if (YIELD_THRESHOLD < time - current)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            cpuRelax();
+        }
+        current = now();
+    }
+}
+
 } //namespace softcam
@@ -19,6 +19,13 @@ class Timer
 
     static void     sleep(float seconds);
 
+    // The monotonic time in nanoseconds, for absolute deadlines.
+    // sleepUntil() is precise; it sleeps until shortly before the time
+    // and then spins for the rest, which costs some CPU time, while
+    // sleep() is for coarse waits.
+    static std::uint64_t    now();
+    static void             sleepUntil(std::uint64_t time);
+
  private:
     std::uint64_t   m_clock;
     std::uint64_t   m_frequency;
@@ -41,6 +48,27 @@ class NamedMutex
 };
 
 
+/// Inter-process Event Notification
+///
+/// A waiter takes the current sequence number before checking its condition
+/// and then waits for the number to change, so that a notification issued
+/// in between is never lost.
+class NamedEvent
+{
+ public:
+    explicit NamedEvent(const char* name);
+
+    std::uint32_t   sequence() const;
+    bool            wait(std::uint32_t sequence, float timeout);
+    void            notify();
+
+ private:
+    std::shared_ptr<void>   m_handle;
+
+    static void closeHandle(void*);
+};
+
+
 /// Inter-process Shared Memory
 class SharedMemory
 {
@@ -48,6 +76,9 @@ class SharedMemory
     SharedMemory() {}
     static SharedMemory create(const char* name, unsigned long size);
     static SharedMemory open(const char* name);
+    static SharedMemory openReadOnly(const char* name);
+    static SharedMemory openOrCreate(const char* name, unsigned long size);
+    static void         unlink(const char* name);
 
     explicit operator bool() const { return get() != nullptr; }
 
@@ -69,4 +100,19 @@ class SharedMemory
 };
 
 
+/// Process Liveness
+///
+/// A process is identified by its ID together with its start time, since
+/// the ID of a terminated process can be reused by another one.
+/// isAlive() returns true if the liveness can't be determined, for example
+/// when the process belongs to another user.
+class Process
+{
+ public:
+    static std::uint32_t    currentId();
+    static std::uint64_t    startTime(std::uint32_t id);
+    static bool             isAlive(std::uint32_t id, std::uint64_t start_time);
+};
+
+
 } //namespace softcam
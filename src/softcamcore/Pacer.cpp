@@ -0,0 +1,119 @@
+#include "Pacer.h"
+
+#include <algorithm>
+#include "Misc.h"
+
+
+namespace softcam {
+
+
+Pacer::Pacer(float framerate, Policy policy) :
+    m_period(0.0 < framerate ? 1e9 / framerate : 0.0),
+    m_policy(policy)
+{
+}
+
+// After this returns, slept() tells if it slept for the deadline and
+// error() how far from the deadline it returned, in nanoseconds; positive
+// if after the deadline. Both are zero for the first frame.
+void Pacer::wait()
+{
+    m_slept = false;
+    m_error = 0;
+    if (m_period <= 0.0)
+    {
+        return;
+    }
+    std::uint64_t now = Timer::now();
+    if (!m_started)
+    {
+        anchor(now);
+        return;
+    }
+    m_index += 1;
+    std::uint64_t due = deadline(m_index);
+    if (now < due)
+    {
+        Timer::sleepUntil(due);
+        now = Timer::now();
+        m_slept = true;
+        m_error = (std::int64_t)(now - due);
+        record(now < due ? due - now : now - due);
+        return;
+    }
+    std::uint64_t late = now - due;
+    m_error = (std::int64_t)late;
+    record(late);
+    switch (m_policy)
+    {
+    case POLICY_DROP:
+        // The next deadline is the first one after now.
+        m_index = (std::uint64_t)((double)(now - m_anchor) / m_period);
+        break;
+    case POLICY_BURST:
+        break;
+    case POLICY_REANCHOR:
+        anchor(now);
+        break;
+    default:
+        if (m_period * 0.5 <= (double)late)
+        {
+            anchor(now);
+        }
+        break;
+    }
+}
+
+void Pacer::reset()
+{
+    m_started = false;
+}
+
+// Percentiles of the absolute difference between the deadlines and the
+// actual times the recent frames were released, in seconds.
+bool Pacer::jitter(float* out_p50, float* out_p99) const
+{
+    if (m_samples.empty())
+    {
+        return false;
+    }
+    // Only the two ranks are selected instead of sorting all samples, as the
+    // sender publishes them while sending frames.
+    m_selection.assign(m_samples.begin(), m_samples.end());
+    auto p50 = m_selection.begin() + (m_selection.size() - 1) * 50 / 100;
+    auto p99 = m_selection.begin() + (m_selection.size() - 1) * 99 / 100;
+    std::nth_element(m_selection.begin(), p50, m_selection.end());
+    std::nth_element(p50, p99, m_selection.end());
+    *out_p50 = (float)(*p50 * 1e-9);
+    *out_p99 = (float)(*p99 * 1e-9);
+    return true;
+}
+
+std::uint64_t Pacer::deadline(std::uint64_t index) const
+{
+    return m_anchor + (std::uint64_t)((double)index * m_period);
+}
+
+void Pacer::anchor(std::uint64_t time)
+{
+    m_started = true;
+    m_anchor = time;
+    m_index = 0;
+}
+
+void Pacer::record(std::uint64_t error)
+{
+    std::uint32_t sample = (std::uint32_t)std::min<std::uint64_t>(error, UINT32_MAX);
+    if (m_samples.size() < NUM_JITTER_SAMPLES)
+    {
+        m_samples.push_back(sample);
+    }
+    else
+    {
+        m_samples[m_next_sample] = sample;
+        m_next_sample = (m_next_sample + 1) % NUM_JITTER_SAMPLES;
+    }
+}
+
+
+} //namespace softcam
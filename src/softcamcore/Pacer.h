@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+namespace softcam {
+
+
+/// Frame Pacing on Absolute Deadlines
+///
+/// The n-th frame is due at the anchor time plus n periods, computed on the
+/// nanosecond clock, so that neither rounding of sleeps nor late frames
+/// accumulate drift. The policy decides what happens to the schedule when
+/// a frame comes after its deadline; a late frame itself is always
+/// released at once.
+class Pacer
+{
+ public:
+    enum Policy
+    {
+        // Catch up within half a period, otherwise start over.
+        POLICY_DEFAULT,
+        // Skip the missed deadlines and keep the phase of the schedule.
+        POLICY_DROP,
+        // Keep every deadline, releasing late frames back-to-back.
+        POLICY_BURST,
+        // Start the schedule over from the late frame.
+        POLICY_REANCHOR,
+    };
+
+    explicit Pacer(float framerate = 0.0f, Policy policy = POLICY_DEFAULT);
+
+    void            wait();
+    void            reset();
+    bool            jitter(float* out_p50, float* out_p99) const;
+    bool            slept() const { return m_slept; }
+    std::int64_t    error() const { return m_error; }
+
+    static constexpr int NUM_JITTER_SAMPLES = 1024;
+
+ private:
+    double                      m_period;   // in nanoseconds
+    Policy                      m_policy;
+    bool                        m_started = false;
+    std::uint64_t               m_anchor = 0;
+    std::uint64_t               m_index = 0;
+    std::vector<std::uint32_t>  m_samples;
+    std::size_t                 m_next_sample = 0;
+    mutable std::vector<std::uint32_t>  m_selection;  // reused by jitter()
+    bool                        m_slept = false;
+    std::int64_t                m_error = 0;
+
+    std::uint64_t   deadline(std::uint64_t index) const;
+    void            anchor(std::uint64_t time);
+    void            record(std::uint64_t error);
+};
+
+
+} //namespace softcam
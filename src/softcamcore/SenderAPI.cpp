@@ -1,9 +1,15 @@
 #include "SenderAPI.h"
 
 #include <atomic>
+#include <memory>
+#include <cstddef>
+#include <climits>
 
 #include "FrameBuffer.h"
-#include "Misc.h"
+#include "FrameQueue.h"
+#include "ImageHash.h"
+#include "InstanceDirectory.h"
+#include "Pacer.h"
 
 
 namespace {
@@ -11,10 +17,140 @@ namespace {
 struct Camera
 {
     softcam::FrameBuffer    m_frame_buffer;
-    softcam::Timer          m_timer;
+    softcam::Pacer          m_pacer;
+    unsigned                m_flags = 0;
+    bool                    m_acquired = false;
+    // the number of frames which have waited for their time
+    std::uint64_t           m_frames_waited = 0;
+    // the hash of the latest image, valid if m_has_hash is true
+    std::uint64_t           m_hash = 0;
+    bool                    m_has_hash = false;
+    // created on the first call of SendFrameAsync
+    std::unique_ptr<softcam::FrameQueue>    m_queue = nullptr;
 };
 
-std::atomic<Camera*>    s_camera;
+// How often, in frames, the jitter of the pacing is published to the stats.
+const std::uint64_t JitterPublishInterval = 16;
+
+// Cameras created in this process; the default instance and named ones.
+const int MaxCameras = 1 + softcam::InstanceDirectory::MAX_INSTANCES;
+std::atomic<Camera*>    s_cameras[MaxCameras];
+
+bool isValidCamera(Camera* target)
+{
+    if (target)
+    {
+        for (auto& camera : s_cameras)
+        {
+            if (camera.load() == target)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool addCamera(Camera* target)
+{
+    for (auto& camera : s_cameras)
+    {
+        Camera* expected = nullptr;
+        if (camera.compare_exchange_strong(expected, target))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool removeCamera(Camera* target)
+{
+    if (target)
+    {
+        for (auto& camera : s_cameras)
+        {
+            Camera* expected = target;
+            if (camera.compare_exchange_strong(expected, nullptr))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+softcam::Pacer::Policy pacingPolicy(unsigned flags)
+{
+    switch (flags & softcam::sender::CAMERA_FLAG_PACING_MASK)
+    {
+    case softcam::sender::CAMERA_FLAG_PACING_DROP:      return softcam::Pacer::POLICY_DROP;
+    case softcam::sender::CAMERA_FLAG_PACING_BURST:     return softcam::Pacer::POLICY_BURST;
+    case softcam::sender::CAMERA_FLAG_PACING_REANCHOR:  return softcam::Pacer::POLICY_REANCHOR;
+    default:                                            return softcam::Pacer::POLICY_DEFAULT;
+    }
+}
+
+void waitForFrameTime(Camera* target)
+{
+    // To deliver frames in the regular period, we sleep here a bit
+    // before we deliver the new frame if it's not the time yet.
+    // The pacer does nothing if the framerate is zero.
+    auto& pacer = target->m_pacer;
+    pacer.wait();
+    target->m_frame_buffer.recordPacing(pacer.slept(), pacer.error());
+
+    // The percentiles of the jitter take a selection over the recent
+    // frames, so they are published on each of the first frames and then
+    // once in a while.
+    target->m_frames_waited += 1;
+    if (target->m_frames_waited <= JitterPublishInterval ||
+        target->m_frames_waited % JitterPublishInterval == 0)
+    {
+        float p50, p99;
+        if (pacer.jitter(&p50, &p99))
+        {
+            target->m_frame_buffer.recordJitter(
+                    (std::uint64_t)((double)p50 * 1e9),
+                    (std::uint64_t)((double)p99 * 1e9));
+        }
+    }
+}
+
+// Tells if the image is the same as the latest one, in which case the frame
+// is not written but still takes its time as the previous frames did.
+// The latest image is known only when it was sent by this check, so every
+// other way of sending a frame should forget it.
+bool skipUnchangedFrame(Camera* target, const void* image_bits, std::ptrdiff_t stride)
+{
+    if (!(target->m_flags & softcam::sender::CAMERA_FLAG_SKIP_UNCHANGED))
+    {
+        return false;
+    }
+    auto& fb = target->m_frame_buffer;
+    std::uint64_t hash = softcam::ImageHash::hashRows(
+                            image_bits, stride, (std::size_t)3 * fb.width(), fb.height());
+    if (target->m_has_hash && hash == target->m_hash)
+    {
+        waitForFrameTime(target);
+        fb.recordUnchangedFrame();
+        return true;
+    }
+    target->m_hash = hash;
+    target->m_has_hash = true;
+    return false;
+}
+
+// The frames sent asynchronously must reach the shared memory before
+// the caller goes back to the synchronous functions, which share the
+// pacer and the image slots with the queue thread.
+void flushFrameQueue(Camera* target)
+{
+    if (target->m_queue)
+    {
+        target->m_queue->flush();
+    }
+}
 
 } //namespace
 
@@ -24,11 +160,30 @@ namespace sender {
 
 CameraHandle    CreateCamera(int width, int height, float framerate)
 {
-    if (auto fb = FrameBuffer::create(width, height, framerate))
+    return CreateCameraNamed(nullptr, width, height, framerate);
+}
+
+CameraHandle    CreateCameraNamed(const char* name, int width, int height, float framerate)
+{
+    return CreateCameraEx(name, width, height, framerate, 0);
+}
+
+CameraHandle    CreateCameraEx(const char* name, int width, int height, float framerate, unsigned flags)
+{
+    if (name && !*name)
     {
-        Camera* camera = new Camera{ fb, Timer() };
-        Camera* expected = nullptr;
-        if (s_camera.compare_exchange_strong(expected, camera))
+        return nullptr;
+    }
+    if (flags & ~(unsigned)(CAMERA_FLAG_BOTTOM_UP | CAMERA_FLAG_PACING_MASK |
+                            CAMERA_FLAG_ASYNC_BLOCK | CAMERA_FLAG_SKIP_UNCHANGED))
+    {
+        return nullptr;
+    }
+    const bool bottom_up = (flags & CAMERA_FLAG_BOTTOM_UP) != 0;
+    if (auto fb = FrameBuffer::create(width, height, framerate, name, bottom_up))
+    {
+        Camera* camera = new Camera{ fb, Pacer(framerate, pacingPolicy(flags)), flags };
+        if (addCamera(camera))
         {
             return camera;
         }
@@ -40,8 +195,9 @@ CameraHandle    CreateCamera(int width, int height, float framerate)
 void            DeleteCamera(CameraHandle camera)
 {
     Camera* target = static_cast<Camera*>(camera);
-    if (target && s_camera.compare_exchange_strong(target, nullptr))
+    if (removeCamera(target))
     {
+        target->m_queue.reset();
         target->m_frame_buffer.deactivate();
         delete target;
     }
@@ -50,63 +206,159 @@ void            DeleteCamera(CameraHandle camera)
 void            SendFrame(CameraHandle camera, const void* image_bits)
 {
     Camera* target = static_cast<Camera*>(camera);
-    if (target && s_camera.load() == target && image_bits)
-    {
-        auto framerate = target->m_frame_buffer.framerate();
-        auto frame_counter = target->m_frame_buffer.frameCounter();
-
-        // To deliver frames in the regular period, we sleep here a bit
-        // before we deliver the new frame if it's not the time yet.
-        // If it's already the time, we deliver it immediately and
-        // let the timer keep running so that if the next frame comes
-        // in time the constant delivery recovers.
-        // However if the delay grew too much (greater than 50 percent
-        // of the period), we reset the timer to avoid continuing
-        // irregular delivery.
-        if (0.0f < framerate)
+    if (isValidCamera(target) && image_bits)
+    {
+        flushFrameQueue(target);
+        if (!skipUnchangedFrame(target, image_bits, (std::ptrdiff_t)3 * target->m_frame_buffer.width()))
         {
-            if (0 == frame_counter) // the first frame
-            {
-                target->m_timer.reset();
-            }
-            else
-            {
-                auto ref_delta = 1.0f / framerate;
-                auto time = target->m_timer.get();
-                if (time < ref_delta)
-                {
-                    Timer::sleep(ref_delta - time);
-                }
-                if (time < ref_delta * 1.5f)
-                {
-                    target->m_timer.rewind(ref_delta);
-                }
-                else
-                {
-                    target->m_timer.reset();
-                }
-            }
+            waitForFrameTime(target);
+            target->m_frame_buffer.write(image_bits);
         }
+        target->m_acquired = false;
+    }
+}
 
-        target->m_frame_buffer.write(image_bits);
+void            SendFrameWithTimestamp(CameraHandle camera, const void* image_bits, std::uint64_t timestamp)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (isValidCamera(target) && image_bits)
+    {
+        flushFrameQueue(target);
+        if (!skipUnchangedFrame(target, image_bits, (std::ptrdiff_t)3 * target->m_frame_buffer.width()))
+        {
+            waitForFrameTime(target);
+            target->m_frame_buffer.write(image_bits, timestamp);
+        }
+        target->m_acquired = false;
     }
 }
 
-bool            WaitForConnection(CameraHandle camera, float timeout)
+bool            SendFrameEx(CameraHandle camera, const void* image_bits, int stride, unsigned flags)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (!isValidCamera(target) || !image_bits || flags != 0)
+    {
+        return false;
+    }
+    auto& fb = target->m_frame_buffer;
+    // INT_MIN is rejected as its negation below would overflow.
+    const int row_size = 3 * fb.width();
+    if ((stride < row_size && -row_size < stride) || stride == INT_MIN)
+    {
+        return false;
+    }
+    // A bottom-up image is given by its lowest row in memory, which is
+    // the bottom row, while FrameBuffer takes the top row.
+    auto top = static_cast<const unsigned char*>(image_bits);
+    if (stride < 0)
+    {
+        top += (std::size_t)-stride * (fb.height() - 1);
+    }
+    flushFrameQueue(target);
+    if (!skipUnchangedFrame(target, top, stride))
+    {
+        waitForFrameTime(target);
+        fb.write(top, stride, Timer::now());
+    }
+    target->m_acquired = false;
+    return true;
+}
+
+bool            SendFrameRegions(CameraHandle camera, const void* image_bits, const Rect* rects, int count)
+{
+    static_assert(sizeof(Rect) == sizeof(FrameBuffer::Rect) &&
+                  offsetof(Rect, x) == offsetof(FrameBuffer::Rect, x) &&
+                  offsetof(Rect, y) == offsetof(FrameBuffer::Rect, y) &&
+                  offsetof(Rect, width) == offsetof(FrameBuffer::Rect, width) &&
+                  offsetof(Rect, height) == offsetof(FrameBuffer::Rect, height),
+                  "Rect should be the same as FrameBuffer::Rect");
+    Camera* target = static_cast<Camera*>(camera);
+    if (!isValidCamera(target) || !image_bits || count < 0 || (!rects && count != 0))
+    {
+        return false;
+    }
+    flushFrameQueue(target);
+    waitForFrameTime(target);
+    target->m_has_hash = false;
+    target->m_frame_buffer.writeRegions(
+            image_bits,
+            reinterpret_cast<const FrameBuffer::Rect*>(rects),
+            count,
+            Timer::now());
+    target->m_acquired = false;
+    return true;
+}
+
+void            SendFrameAsync(CameraHandle camera, const void* image_bits)
 {
     Camera* target = static_cast<Camera*>(camera);
-    if (target && s_camera.load() == target)
+    if (isValidCamera(target) && image_bits)
     {
-        Timer timer;
-        while (!target->m_frame_buffer.connected())
+        if (!target->m_queue)
         {
-            if (0.0f < timeout && timeout <= timer.get())
-            {
-                return false;
-            }
-            Timer::sleep(0.001f);
+            auto& fb = target->m_frame_buffer;
+            auto policy = (target->m_flags & CAMERA_FLAG_ASYNC_BLOCK) ?
+                                FrameQueue::OVERFLOW_BLOCK :
+                                FrameQueue::OVERFLOW_DROP_OLDEST;
+            target->m_queue.reset(new FrameQueue(
+                (std::size_t)fb.width() * fb.height() * 3,
+                FRAME_QUEUE_CAPACITY,
+                policy,
+                [target](const void* bits, std::uint64_t timestamp)
+                {
+                    waitForFrameTime(target);
+                    target->m_frame_buffer.write(bits, timestamp);
+                }));
         }
-        return true;
+        // The frame is stamped with the time it was given rather than
+        // the time it is delivered.
+        target->m_queue->push(image_bits, Timer::now());
+        target->m_acquired = false;
+        target->m_has_hash = false;
+    }
+}
+
+int             GetFrameQueueDepth(CameraHandle camera)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (isValidCamera(target) && target->m_queue)
+    {
+        return target->m_queue->depth();
+    }
+    return 0;
+}
+
+bool            AcquireFrameBuffer(CameraHandle camera, void** out_image_bits, int* out_stride)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (isValidCamera(target) && out_image_bits && out_stride)
+    {
+        flushFrameQueue(target);
+        *out_image_bits = target->m_frame_buffer.acquireImage(out_stride);
+        target->m_acquired = *out_image_bits != nullptr;
+        target->m_has_hash = false;
+        return target->m_acquired;
+    }
+    return false;
+}
+
+void            CommitFrame(CameraHandle camera)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (isValidCamera(target) && target->m_acquired)
+    {
+        waitForFrameTime(target);
+        target->m_frame_buffer.commitImage();
+        target->m_acquired = false;
+    }
+}
+
+bool            WaitForConnection(CameraHandle camera, float timeout)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (isValidCamera(target))
+    {
+        return target->m_frame_buffer.waitForConnection(timeout);
     }
     return false;
 }
@@ -114,12 +366,45 @@ bool            WaitForConnection(CameraHandle camera, float timeout)
 bool            IsConnected(CameraHandle camera)
 {
     Camera* target = static_cast<Camera*>(camera);
-    if (target && s_camera.load() == target)
+    if (isValidCamera(target))
     {
         return target->m_frame_buffer.connected();
     }
     return false;
 }
 
+bool            GetCameraStats(CameraHandle camera, CameraStats* out_stats)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    FrameBuffer::Stats stats;
+    if (isValidCamera(target) && out_stats && target->m_frame_buffer.stats(&stats))
+    {
+        *out_stats = CameraStats{};
+        out_stats->frames_written = stats.m_frames_written;
+        for (auto& receiver : stats.m_receivers)
+        {
+            if (receiver.m_in_use)
+            {
+                out_stats->frames_read += receiver.m_frames_read;
+                out_stats->frames_skipped += receiver.m_frames_skipped;
+                out_stats->receivers += 1;
+            }
+        }
+        out_stats->paced_frames = stats.m_paced_frames;
+        out_stats->late_frames = stats.m_late_frames;
+        out_stats->oversleep_ns = stats.m_oversleep;
+        out_stats->max_oversleep_ns = stats.m_max_oversleep;
+        out_stats->undersleep_ns = stats.m_undersleep;
+        out_stats->mutex_waits = stats.m_mutex_waits;
+        out_stats->mutex_wait_ns = stats.m_mutex_wait_time;
+        out_stats->max_mutex_wait_ns = stats.m_max_mutex_wait_time;
+        out_stats->unchanged_frames = stats.m_unchanged_frames;
+        out_stats->jitter_p50_ns = stats.m_jitter_p50;
+        out_stats->jitter_p99_ns = stats.m_jitter_p99;
+        return true;
+    }
+    return false;
+}
+
 } //namespace sender
 } //namespace softcam
@@ -1,16 +1,79 @@
 #pragma once
 
+#include <cstdint>
+
 
 namespace softcam {
 namespace sender {
 
 using CameraHandle = void*;
 
+enum CameraFlags : unsigned
+{
+    CAMERA_FLAG_BOTTOM_UP = 0x0001,
+
+    // The policy to catch up with the schedule after a late frame,
+    // stored in a two-bit field.
+    CAMERA_FLAG_PACING_DROP = 0x0010,
+    CAMERA_FLAG_PACING_BURST = 0x0020,
+    CAMERA_FLAG_PACING_REANCHOR = 0x0030,
+    CAMERA_FLAG_PACING_MASK = 0x0030,
+
+    // SendFrameAsync waits for room in the queue instead of dropping
+    // the oldest queued frame.
+    CAMERA_FLAG_ASYNC_BLOCK = 0x0100,
+
+    // SendFrame doesn't write a frame which is the same as the previous one.
+    CAMERA_FLAG_SKIP_UNCHANGED = 0x0200,
+};
+
+// The number of frames SendFrameAsync keeps waiting for their time.
+constexpr int FRAME_QUEUE_CAPACITY = 3;
+
+// A rectangle in pixels from the top-left corner; see scRect.
+struct Rect
+{
+    int     x;
+    int     y;
+    int     width;
+    int     height;
+};
+
+// The statistics of a camera; see scCameraStats.
+struct CameraStats
+{
+    std::uint64_t   frames_written;
+    std::uint64_t   frames_read;
+    std::uint64_t   frames_skipped;
+    std::uint32_t   receivers;
+    std::uint64_t   paced_frames;
+    std::uint64_t   late_frames;
+    std::uint64_t   oversleep_ns;
+    std::uint64_t   max_oversleep_ns;
+    std::uint64_t   undersleep_ns;
+    std::uint64_t   mutex_waits;
+    std::uint64_t   mutex_wait_ns;
+    std::uint64_t   max_mutex_wait_ns;
+    std::uint64_t   unchanged_frames;
+    std::uint64_t   jitter_p50_ns;
+    std::uint64_t   jitter_p99_ns;
+};
+
 CameraHandle    CreateCamera(int width, int height, float framerate = 60.0f);
+CameraHandle    CreateCameraNamed(const char* name, int width, int height, float framerate = 60.0f);
+CameraHandle    CreateCameraEx(const char* name, int width, int height, float framerate, unsigned flags);
 void            DeleteCamera(CameraHandle camera);
 void            SendFrame(CameraHandle camera, const void* image_bits);
+void            SendFrameWithTimestamp(CameraHandle camera, const void* image_bits, std::uint64_t timestamp);
+bool            SendFrameEx(CameraHandle camera, const void* image_bits, int stride, unsigned flags);
+bool            SendFrameRegions(CameraHandle camera, const void* image_bits, const Rect* rects, int count);
+void            SendFrameAsync(CameraHandle camera, const void* image_bits);
+int             GetFrameQueueDepth(CameraHandle camera);
+bool            AcquireFrameBuffer(CameraHandle camera, void** out_image_bits, int* out_stride);
+void            CommitFrame(CameraHandle camera);
 bool            WaitForConnection(CameraHandle camera, float timeout = 0.0f);
 bool            IsConnected(CameraHandle camera);
+bool            GetCameraStats(CameraHandle camera, CameraStats* out_stats);
 
 } //namespace sender
 } //namespace softcam
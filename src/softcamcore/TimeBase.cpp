@@ -0,0 +1,64 @@
+#include "TimeBase.h"
+
+#include <algorithm>
+
+
+namespace softcam {
+
+
+TimeBase::TimeBase(std::uint64_t origin) :
+    m_origin(origin)
+{
+}
+
+// Starts a new stream whose time zero is the given local time.
+void TimeBase::reset(std::uint64_t origin)
+{
+    *this = TimeBase(origin);
+}
+
+// Forgets the timestamps seen so far, e.g. because the sender has changed,
+// while keeping the stream time going.
+void TimeBase::restart()
+{
+    m_anchored = false;
+}
+
+// Returns the stream time of the frame with the given timestamp which has
+// arrived at the local time `now`, both in nanoseconds.
+std::uint64_t TimeBase::map(std::uint64_t timestamp, std::uint64_t now)
+{
+    std::uint64_t local = m_origin < now ? now - m_origin : 0;
+    if (m_anchored && m_last_timestamp <= timestamp)
+    {
+        std::uint64_t mapped = m_anchor_time + (timestamp - m_anchor_timestamp);
+        std::uint64_t deviation = mapped < local ? local - mapped : mapped - local;
+        if (deviation <= MAX_DEVIATION)
+        {
+            m_last_timestamp = timestamp;
+            return advance(mapped);
+        }
+    }
+    m_anchored = true;
+    m_anchor_timestamp = timestamp;
+    m_anchor_time = std::max(m_next_time, local);
+    m_last_timestamp = timestamp;
+    return advance(m_anchor_time);
+}
+
+// Returns the stream time of a sample which delivers the last frame again
+// at the local time `now`, since no new frame has arrived.
+std::uint64_t TimeBase::repeat(std::uint64_t now)
+{
+    std::uint64_t local = m_origin < now ? now - m_origin : 0;
+    return advance(local);
+}
+
+std::uint64_t TimeBase::advance(std::uint64_t time)
+{
+    time = std::max(m_next_time, time);
+    m_next_time = time + MIN_STEP;
+    return time;
+}
+
+} //namespace softcam
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace softcam {
+
+
+/// Mapping of frame timestamps given by a sender to the stream time of
+/// a receiver
+///
+/// The timestamps are in nanoseconds on a clock of the sender, whose
+/// epoch the receiver doesn't know. The first frame is mapped to the local
+/// time it arrives, and each following frame keeps its distance from that
+/// frame, so that the stream times follow the capture times instead of
+/// the nominal frame interval. The mapping starts over if the timestamps
+/// go backwards or stray from the local clock by more than MAX_DEVIATION,
+/// such as when another sender has taken over or the clocks have drifted.
+/// A sample repeating the last frame while no new frame arrives follows
+/// the local clock instead.
+/// The stream times always increase, by at least MIN_STEP, so that no two
+/// samples start at the same time.
+class TimeBase
+{
+ public:
+    explicit TimeBase(std::uint64_t origin = 0);
+
+    void            reset(std::uint64_t origin);
+    void            restart();
+    std::uint64_t   map(std::uint64_t timestamp, std::uint64_t now);
+    std::uint64_t   repeat(std::uint64_t now);
+
+    static constexpr std::uint64_t MAX_DEVIATION = 500000000; // 0.5 seconds
+    static constexpr std::uint64_t MIN_STEP = 100; // a unit of REFERENCE_TIME
+
+ private:
+    std::uint64_t   m_origin;               // the local time of stream time zero
+    bool            m_anchored = false;
+    std::uint64_t   m_anchor_timestamp = 0;
+    std::uint64_t   m_anchor_time = 0;      // in stream time
+    std::uint64_t   m_last_timestamp = 0;
+    std::uint64_t   m_next_time = 0;        // the earliest stream time of the next sample
+
+    std::uint64_t   advance(std::uint64_t time);
+};
+
+
+} //namespace softcam
@@ -2,38 +2,270 @@
 
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
 #include "Misc.h"
 
 
 namespace softcam {
 
+
+namespace {
+
+// The process-wide scheduler which runs every heartbeat and monitor.
+//
+// Tasks are kept in a hashed timer wheel with 1 ms ticks; each task is
+// stored in the bucket of its absolute due tick modulo the wheel size,
+// so a bucket can also hold tasks due in later laps of the wheel.
+// The thread sleeps until the next non-empty bucket, and it exists only
+// while at least one task is registered.
+// All callbacks run one at a time on the scheduler thread, so they should
+// be short.
+class Scheduler
+{
+ public:
+    static Scheduler&   instance()
+    {
+        // Intentionally leaked so that watchdogs released during static
+        // destruction still find a valid scheduler.
+        static Scheduler* scheduler = new Scheduler();
+        return *scheduler;
+    }
+
+    std::uint64_t   add(float delay, float interval, std::function<void()> task);
+    void            remove(std::uint64_t id);
+
+ private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr int        WHEEL_SIZE = 256;
+    static constexpr double     TICK = 0.001;
+
+    struct Task
+    {
+        std::function<void()>   m_task;
+        std::uint64_t           m_interval;     // in ticks
+        std::uint64_t           m_due;          // in ticks
+        bool                    m_running = false;
+        bool                    m_removed = false;
+    };
+
+    std::mutex                  m_mutex;
+    std::condition_variable     m_wakeup;
+    std::condition_variable     m_finished;
+    std::thread                 m_thread;
+    std::uint64_t               m_generation = 0;
+    bool                        m_active = false;
+    const Clock::time_point     m_origin = Clock::now();
+    std::uint64_t               m_current = 0;  // the last processed tick
+    std::uint64_t               m_next_id = 1;
+    std::unordered_map<std::uint64_t, Task> m_tasks;
+    std::vector<std::uint64_t>  m_wheel[WHEEL_SIZE];
+
+    static std::uint64_t    toTicks(float seconds);
+    std::uint64_t           now() const;
+    Clock::time_point       timeOf(std::uint64_t tick) const;
+    void                    schedule(std::uint64_t id, Task& task);
+    void                    run(std::uint64_t generation);
+};
+
+std::uint64_t Scheduler::add(float delay, float interval, std::function<void()> task)
+{
+    std::thread finished;
+    std::uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        id = m_next_id++;
+        auto& t = m_tasks[id];
+        t.m_task = std::move(task);
+        t.m_interval = std::max<std::uint64_t>(1, toTicks(interval));
+        t.m_due = std::max(now(), m_current) + toTicks(delay);
+        schedule(id, t);
+
+        if (!m_active)
+        {
+            // The previous thread may still be exiting; it is not ours to
+            // join anymore once a new generation starts.
+            m_active = true;
+            m_generation += 1;
+            finished = std::move(m_thread);
+            m_thread = std::thread(&Scheduler::run, this, m_generation);
+        }
+        else
+        {
+            m_wakeup.notify_all();
+        }
+    }
+    if (finished.joinable())
+    {
+        finished.join();
+    }
+    return id;
+}
+
+void Scheduler::remove(std::uint64_t id)
+{
+    std::thread finished;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        auto it = m_tasks.find(id);
+        if (it == m_tasks.end())
+        {
+            return;
+        }
+        bool on_scheduler = std::this_thread::get_id() == m_thread.get_id();
+        if (!on_scheduler)
+        {
+            // The callback may refer to the owner being destroyed.
+            it->second.m_removed = true;
+            m_finished.wait(lock, [&] { return !it->second.m_running; });
+        }
+        m_tasks.erase(it);
+
+        if (m_tasks.empty())
+        {
+            m_active = false;
+            m_generation += 1;
+            m_wakeup.notify_all();
+            if (on_scheduler)
+            {
+                m_thread.detach();
+            }
+            else
+            {
+                finished = std::move(m_thread);
+            }
+        }
+    }
+    if (finished.joinable())
+    {
+        finished.join();
+    }
+}
+
+std::uint64_t Scheduler::toTicks(float seconds)
+{
+    return seconds <= 0.0f ? 0 : (std::uint64_t)(seconds / TICK + 0.5);
+}
+
+std::uint64_t Scheduler::now() const
+{
+    std::chrono::duration<double> elapsed = Clock::now() - m_origin;
+    return (std::uint64_t)(elapsed.count() / TICK);
+}
+
+Scheduler::Clock::time_point Scheduler::timeOf(std::uint64_t tick) const
+{
+    return m_origin + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double>(tick * TICK));
+}
+
+void Scheduler::schedule(std::uint64_t id, Task& task)
+{
+    if (task.m_due <= m_current)
+    {
+        task.m_due = m_current + 1;
+    }
+    m_wheel[task.m_due % WHEEL_SIZE].push_back(id);
+}
+
+void Scheduler::run(std::uint64_t generation)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::vector<std::uint64_t> bucket;
+    while (m_generation == generation)
+    {
+        std::uint64_t next = m_current + 1;
+        while (next - m_current < WHEEL_SIZE && m_wheel[next % WHEEL_SIZE].empty())
+        {
+            next += 1;
+        }
+        m_wakeup.wait_until(lock, timeOf(next));
+        if (m_generation != generation)
+        {
+            break;
+        }
+
+        std::uint64_t target = now();
+        if (m_current + WHEEL_SIZE < target)
+        {
+            // After a long stall such as a system suspend, catching up with
+            // every missed tick is pointless.
+            m_current = target - WHEEL_SIZE;
+        }
+        while (m_current < target && m_generation == generation)
+        {
+            m_current += 1;
+            bucket.clear();
+            bucket.swap(m_wheel[m_current % WHEEL_SIZE]);
+            for (auto id : bucket)
+            {
+                auto it = m_tasks.find(id);
+                if (it == m_tasks.end())
+                {
+                    continue;   // removed
+                }
+                Task& task = it->second;
+                if (task.m_removed)
+                {
+                    continue;
+                }
+                if (m_current < task.m_due)
+                {
+                    m_wheel[m_current % WHEEL_SIZE].push_back(id);
+                    continue;   // due in a later lap
+                }
+                // Other threads can't erase the task while it's running,
+                // but the task itself may remove it through its owner.
+                task.m_running = true;
+                lock.unlock();
+                task.m_task();
+                lock.lock();
+                it = m_tasks.find(id);
+                if (it == m_tasks.end())
+                {
+                    continue;
+                }
+                it->second.m_running = false;
+                m_finished.notify_all();
+                if (it->second.m_removed)
+                {
+                    continue;
+                }
+
+                // Missed beats are skipped rather than bursted.
+                it->second.m_due += it->second.m_interval;
+                schedule(id, it->second);
+            }
+        }
+    }
+}
+
+} //namespace
+
+
 Watchdog Watchdog::createHeartbeat(
                             float                       interval,
                             std::function<void()>       increment)
 {
     struct Heartbeat
     {
-        std::atomic<bool>   m_quit = false;
         std::atomic<bool>   m_alive = true; // dummy
-        std::thread         m_thread;
+        std::uint64_t       m_task = 0;
         ~Heartbeat()
         {
-            m_quit = true;
-            m_thread.join();
+            Scheduler::instance().remove(m_task);
         }
     };
 
     auto heartbeat = std::make_shared<Heartbeat>();
-    auto quit = &heartbeat->m_quit;
-
-    heartbeat->m_thread = std::thread([quit, interval, increment]
-    {
-        while (!quit->load())
-        {
-            Timer::sleep(interval);
-            increment();
-        }
-    });
+    heartbeat->m_task = Scheduler::instance().add(interval, interval, increment);
 
     std::shared_ptr<std::atomic<bool>> holder(heartbeat, &heartbeat->m_alive);
 
@@ -49,37 +281,42 @@ Watchdog Watchdog::createMonitor(
 {
     struct Monitor
     {
-        std::atomic<bool>   m_quit = false;
         std::atomic<bool>   m_alive = true;
-        std::thread         m_thread;
+        std::uint64_t       m_task = 0;
+        // accessed only by the scheduler thread
+        bool                m_started = false;
+        unsigned            m_last_value = 0;
+        Timer               m_timer;
         ~Monitor()
         {
-            m_quit = true;
-            m_thread.join();
+            Scheduler::instance().remove(m_task);
         }
     };
 
     auto monitor = std::make_shared<Monitor>();
     auto ptr = monitor.get();
 
-    monitor->m_thread = std::thread([ptr, interval, timeout, read]
+    // The first call only takes the initial value; it runs on the scheduler
+    // thread because the caller may be holding a lock that read() takes.
+    monitor->m_task = Scheduler::instance().add(0.0f, interval, [ptr, timeout, read]
     {
-        unsigned last_value = read();
-        Timer timer;
-        while (!ptr->m_quit.load())
+        unsigned value = read();
+        if (!ptr->m_started)
         {
-            Timer::sleep(interval);
-            unsigned value = read();
-            if (last_value != value)
-            {
-                last_value = value;
-                ptr->m_alive = true;
-                timer.reset();
-            }
-            if (timeout < timer.get())
-            {
-                ptr->m_alive = false;
-            }
+            ptr->m_started = true;
+            ptr->m_last_value = value;
+            ptr->m_timer.reset();
+            return;
+        }
+        if (ptr->m_last_value != value)
+        {
+            ptr->m_last_value = value;
+            ptr->m_alive = true;
+            ptr->m_timer.reset();
+        }
+        if (timeout < ptr->m_timer.get())
+        {
+            ptr->m_alive = false;
         }
     });
 
@@ -0,0 +1,38 @@
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include <cstring>
+
+
+// Runs the benchmarks and writes the results to core_benchmarks.json
+// unless another output is given with --benchmark_out, so that the results
+// of a change can be compared with those before it by tools/compare.py of
+// Google Benchmark.
+int main(int argc, char** argv)
+{
+    std::vector<char*> args(argv, argv + argc);
+    bool has_out = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strncmp(argv[i], "--benchmark_out=", 16) == 0)
+        {
+            has_out = true;
+        }
+    }
+    char out[] = "--benchmark_out=core_benchmarks.json";
+    char out_format[] = "--benchmark_out_format=json";
+    if (!has_out)
+    {
+        args.push_back(out);
+        args.push_back(out_format);
+    }
+    int count = (int)args.size();
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
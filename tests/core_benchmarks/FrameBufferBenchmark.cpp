@@ -0,0 +1,235 @@
+#include <softcamcore/FrameBuffer.h>
+#include <softcamcore/Misc.h>
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+
+
+namespace FrameBufferBenchmark {
+namespace sc = softcam;
+
+// From QVGA up to the largest size FrameBuffer accepts.
+const int RESOLUTIONS[][2] = {
+    { 320, 240 },
+    { 640, 480 },
+    { 1280, 720 },
+    { 1920, 1080 },
+    { 3840, 2160 },
+    { 7680, 4320 },
+    { 16384, 16384 },
+};
+const int MAX_RECEIVERS = 8;
+// as many as the image slots in the shared memory
+const int WARM_UP_FRAMES = 3;
+
+void ResolutionsAndReceivers(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "width", "height", "receivers" });
+    for (auto& resolution : RESOLUTIONS)
+    {
+        for (int receivers = 1; receivers <= MAX_RECEIVERS; receivers *= 2)
+        {
+            b->Args({ resolution[0], resolution[1], receivers });
+        }
+    }
+}
+
+void Receivers(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "receivers" });
+    for (int receivers = 1; receivers <= MAX_RECEIVERS; receivers *= 2)
+    {
+        b->Args({ receivers });
+    }
+}
+
+
+/// Receivers running on their own threads during a benchmark
+///
+/// Each receiver either follows the sender, copying every new frame as
+/// a DirectShow filter does, or copies the latest frame over and over to
+/// put the most load on the shared memory.
+class BackgroundReceivers
+{
+ public:
+    BackgroundReceivers(int count, bool follow_sender) :
+        m_copied(count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            m_threads.emplace_back([this, follow_sender, &copied = m_copied[i]]
+            {
+                auto fb = sc::FrameBuffer::open();
+                std::vector<uint8_t> image((std::size_t)3 * fb.width() * fb.height());
+                uint64_t frame_counter = 0;
+                while (!m_stop.load())
+                {
+                    if (!follow_sender || fb.waitForNewFrame(frame_counter, 0.05f))
+                    {
+                        fb.transferToDIB(image.data(), &frame_counter);
+                        copied.store(frame_counter);
+                    }
+                }
+            });
+        }
+    }
+
+    // Waits until every receiver has copied the frame or a later one.
+    void waitForCopies(uint64_t frame_counter)
+    {
+        for (auto& copied : m_copied)
+        {
+            while (copied.load() < frame_counter)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    ~BackgroundReceivers()
+    {
+        m_stop = true;
+        for (auto& th : m_threads)
+        {
+            th.join();
+        }
+    }
+
+ private:
+    std::atomic<bool>           m_stop{ false };
+    std::vector<std::atomic<uint64_t>>  m_copied;
+    std::vector<std::thread>    m_threads;
+};
+
+
+// Writes a frame into each image slot and waits for the receivers to copy
+// each of them, so that every page of the shared memory is mapped in
+// the sender and the receivers before the timing starts. Otherwise the few
+// iterations run on the largest frames mostly measure page faults.
+void warmUp(sc::FrameBuffer& fb, const std::vector<uint8_t>& image, BackgroundReceivers& receivers)
+{
+    for (int i = 0; i < WARM_UP_FRAMES; i++)
+    {
+        fb.write(image.data());
+        receivers.waitForCopies(fb.frameCounter());
+    }
+}
+
+
+// The time to write a frame while the receivers copy every frame.
+void BM_Write(benchmark::State& state)
+{
+    const int width = (int)state.range(0);
+    const int height = (int)state.range(1);
+    auto fb = sc::FrameBuffer::create(width, height, 0.0f);
+    if (!fb)
+    {
+        state.SkipWithError("failed to create the frame buffer");
+        return;
+    }
+    std::vector<uint8_t> image((std::size_t)3 * width * height, 123);
+    BackgroundReceivers receivers((int)state.range(2), true);
+    warmUp(fb, image, receivers);
+
+    for (auto _ : state)
+    {
+        fb.write(image.data());
+    }
+    state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)image.size());
+}
+BENCHMARK(BM_Write)->Apply(ResolutionsAndReceivers)->UseRealTime();
+
+
+// The time for a receiver to copy a frame while the other receivers
+// copy the same frame at the same time.
+void BM_TransferToDIB(benchmark::State& state)
+{
+    const int width = (int)state.range(0);
+    const int height = (int)state.range(1);
+    auto sender = sc::FrameBuffer::create(width, height, 0.0f);
+    if (!sender)
+    {
+        state.SkipWithError("failed to create the frame buffer");
+        return;
+    }
+    std::vector<uint8_t> image((std::size_t)3 * width * height, 123);
+    auto fb = sc::FrameBuffer::open();
+    BackgroundReceivers receivers((int)state.range(2) - 1, false);
+    warmUp(sender, image, receivers);
+
+    uint64_t frame_counter = 0;
+    fb.transferToDIB(image.data(), &frame_counter);
+    for (auto _ : state)
+    {
+        fb.transferToDIB(image.data(), &frame_counter);
+        benchmark::DoNotOptimize(image.data());
+    }
+    state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)image.size());
+}
+BENCHMARK(BM_TransferToDIB)->Apply(ResolutionsAndReceivers)->UseRealTime();
+
+
+// The time from committing a frame until the last of the receivers waiting
+// in waitForNewFrame() has woken up.
+void BM_WaitForNewFrameWakeUp(benchmark::State& state)
+{
+    const int num_receivers = (int)state.range(0);
+    auto fb = sc::FrameBuffer::create(320, 240, 0.0f);
+    std::atomic<uint64_t> commit_time{ 0 };
+    std::atomic<uint64_t> max_latency{ 0 };
+    std::atomic<int> woken{ 0 };
+    std::atomic<bool> stop{ false };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_receivers; i++)
+    {
+        threads.emplace_back([&]
+        {
+            auto receiver = sc::FrameBuffer::open();
+            uint64_t frame_counter = receiver.frameCounter();
+            while (!stop.load())
+            {
+                if (receiver.waitForNewFrame(frame_counter, 0.05f) &&
+                    frame_counter < receiver.frameCounter())
+                {
+                    uint64_t latency = sc::Timer::now() - commit_time.load();
+                    uint64_t max = max_latency.load();
+                    while (max < latency && !max_latency.compare_exchange_weak(max, latency)) {}
+                    frame_counter = receiver.frameCounter();
+                    woken.fetch_add(1);
+                }
+            }
+        });
+    }
+
+    uint64_t total_latency = 0;
+    for (auto _ : state)
+    {
+        // Let the receivers go back to sleep.
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        max_latency = 0;
+        woken = 0;
+        fb.acquireImage(nullptr);
+        commit_time = sc::Timer::now();
+        fb.commitImage();
+        while (woken.load() < num_receivers)
+        {
+            std::this_thread::yield();
+        }
+        total_latency += max_latency.load();
+        state.SetIterationTime((double)max_latency.load() * 1e-9);
+    }
+    stop = true;
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    state.counters["latency_us"] = benchmark::Counter(
+        (double)total_latency * 1e-3 / (double)state.iterations());
+}
+BENCHMARK(BM_WaitForNewFrameWakeUp)->Apply(Receivers)->UseManualTime();
+
+} //namespace FrameBufferBenchmark
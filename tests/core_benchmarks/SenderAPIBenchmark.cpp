@@ -0,0 +1,57 @@
+#include <softcamcore/SenderAPI.h>
+#include <softcamcore/Misc.h>
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+
+namespace SenderAPIBenchmark {
+namespace sc = softcam;
+namespace sender = softcam::sender;
+
+
+// How far the intervals between the returns of SendFrame() deviate from
+// the frame interval.
+void BM_SendFramePacingJitter(benchmark::State& state)
+{
+    const int framerate = (int)state.range(0);
+    const int64_t interval = 1000000000 / framerate;
+    auto camera = sender::CreateCamera(320, 240, (float)framerate);
+    if (!camera)
+    {
+        state.SkipWithError("failed to create the camera");
+        return;
+    }
+    std::vector<uint8_t> image(320 * 240 * 3, 123);
+    std::vector<uint64_t> jitters;
+    jitters.reserve(state.max_iterations);
+
+    sender::SendFrame(camera, image.data());
+    uint64_t last = sc::Timer::now();
+    for (auto _ : state)
+    {
+        sender::SendFrame(camera, image.data());
+        uint64_t now = sc::Timer::now();
+        int64_t error = (int64_t)(now - last) - interval;
+        jitters.push_back((uint64_t)(error < 0 ? -error : error));
+        last = now;
+    }
+    sender::DeleteCamera(camera);
+
+    std::sort(jitters.begin(), jitters.end());
+    uint64_t sum = 0;
+    for (auto jitter : jitters)
+    {
+        sum += jitter;
+    }
+    state.counters["jitter_avg_us"] = (double)sum * 1e-3 / (double)jitters.size();
+    state.counters["jitter_p99_us"] = (double)jitters[jitters.size() * 99 / 100] * 1e-3;
+    state.counters["jitter_max_us"] = (double)jitters.back() * 1e-3;
+}
+BENCHMARK(BM_SendFramePacingJitter)
+    ->ArgName("fps")->Arg(30)->Arg(60)->Arg(120)->Arg(240)
+    ->MinTime(2.0)->UseRealTime();
+
+} //namespace SenderAPIBenchmark
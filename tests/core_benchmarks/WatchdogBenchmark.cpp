@@ -0,0 +1,101 @@
+#include <softcamcore/Watchdog.h>
+#include <softcamcore/FrameBuffer.h>
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+
+namespace WatchdogBenchmark {
+namespace sc = softcam;
+
+// The CPU time consumed by all threads of this process in nanoseconds.
+uint64_t processCpuTime()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    auto to_ns = [](const FILETIME& t)
+    {
+        return (((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) * 100;
+    };
+    return to_ns(kernel) + to_ns(user);
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    auto to_ns = [](const struct timeval& t)
+    {
+        return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_usec * 1000;
+    };
+    return to_ns(usage.ru_utime) + to_ns(usage.ru_stime);
+#endif
+}
+
+
+// The cost of asking a monitor whether its peer is alive, which receivers
+// do on every frame.
+void BM_WatchdogAlive(benchmark::State& state)
+{
+    std::atomic<unsigned> heartbeat{ 0 };
+    auto monitor = sc::Watchdog::createMonitor(
+        sc::FrameBuffer::WATCHDOG_MONITOR_INTERVAL,
+        sc::FrameBuffer::WATCHDOG_TIMEOUT,
+        [&] { return heartbeat.load(); });
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(monitor.alive());
+    }
+}
+BENCHMARK(BM_WatchdogAlive);
+
+
+// The cost of starting and stopping a heartbeat, which every frame buffer
+// pays when it is opened and released.
+void BM_WatchdogCreateAndStop(benchmark::State& state)
+{
+    std::atomic<unsigned> heartbeat{ 0 };
+    for (auto _ : state)
+    {
+        auto watchdog = sc::Watchdog::createHeartbeat(
+            sc::FrameBuffer::WATCHDOG_HEARTBEAT_INTERVAL,
+            [&] { heartbeat.fetch_add(1); });
+        watchdog.stop();
+    }
+}
+BENCHMARK(BM_WatchdogCreateAndStop);
+
+
+// The CPU time the watchdogs of frame buffers with the given number of
+// receivers take in the background, per second of wall time.
+void BM_WatchdogBackgroundLoad(benchmark::State& state)
+{
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    std::vector<sc::FrameBuffer> receivers;
+    for (int i = 0; i < state.range(0); i++)
+    {
+        receivers.push_back(sc::FrameBuffer::open());
+    }
+
+    uint64_t cpu_time = 0;
+    for (auto _ : state)
+    {
+        uint64_t start = processCpuTime();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cpu_time += processCpuTime() - start;
+    }
+    state.counters["cpu_us_per_s"] = benchmark::Counter(
+        (double)cpu_time * 1e-3 / (0.1 * (double)state.iterations()));
+}
+BENCHMARK(BM_WatchdogBackgroundLoad)
+    ->ArgName("receivers")->DenseRange(1, 8)->Iterations(10)->UseRealTime();
+
+} //namespace WatchdogBenchmark
@@ -0,0 +1,168 @@
+#include <softcamcore/CopyEngine.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <softcamcore/Misc.h>
+
+
+namespace CopyEngineTest {
+namespace sc = softcam;
+
+const sc::CopyEngine::Method ALL_METHODS[] = {
+    sc::CopyEngine::METHOD_MEMCPY,
+    sc::CopyEngine::METHOD_SSE2,
+    sc::CopyEngine::METHOD_AVX,
+};
+
+std::vector<uint8_t> makePattern(std::size_t size)
+{
+    std::vector<uint8_t> data(size);
+    for (std::size_t i = 0; i < size; i++)
+    {
+        data[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    return data;
+}
+
+TEST(CopyEngine, MemcpyIsAlwaysSupported) {
+    EXPECT_TRUE( sc::CopyEngine::isSupported(sc::CopyEngine::METHOD_MEMCPY) );
+    EXPECT_TRUE( sc::CopyEngine::isSupported(sc::CopyEngine::bestMethod()) );
+}
+
+TEST(CopyEngine, CopiesExactly) {
+    const std::size_t SIZES[] = { 0, 1, 255, 256, 1000, 4096 + 17, 320 * 240 * 3 };
+
+    for (auto method : ALL_METHODS)
+    {
+        for (auto size : SIZES)
+        {
+            for (std::size_t offset = 0; offset < 40; offset += 13)
+            {
+                // surrounded by guard bytes to detect overrun
+                auto src = makePattern(size + 64);
+                std::vector<uint8_t> dest(size + 64 + offset, 0xcc);
+
+                sc::CopyEngine::copy(method, dest.data() + offset, src.data() + 3, size);
+
+                for (std::size_t i = 0; i < offset; i++)
+                {
+                    ASSERT_EQ( dest[i], 0xcc );
+                }
+                for (std::size_t i = 0; i < size; i++)
+                {
+                    ASSERT_EQ( dest[offset + i], src[3 + i] ) << "method=" << method << " size=" << size;
+                }
+                for (std::size_t i = offset + size; i < dest.size(); i++)
+                {
+                    ASSERT_EQ( dest[i], 0xcc );
+                }
+            }
+        }
+    }
+}
+
+TEST(CopyEngine, CopiesLargeImage) {
+    const std::size_t size = sc::CopyEngine::NON_TEMPORAL_THRESHOLD + 12345;
+    auto src = makePattern(size);
+    std::vector<uint8_t> dest(size);
+
+    sc::CopyEngine::copy(dest.data(), src.data(), size);
+
+    EXPECT_EQ( dest, src );
+}
+
+TEST(CopyEngine, CopyRows) {
+    const std::size_t ROW = 1024 * 3, ROWS = 2000; // larger than the threshold
+    auto src = makePattern(ROW * ROWS);
+
+    {
+        // flipping vertically
+        std::vector<uint8_t> dest(ROW * ROWS, 0);
+        sc::CopyEngine::copyRows(
+            dest.data() + ROW * (ROWS - 1), -(std::ptrdiff_t)ROW,
+            src.data(), (std::ptrdiff_t)ROW,
+            ROW, ROWS);
+        for (std::size_t y = 0; y < ROWS; y++)
+        {
+            ASSERT_EQ( std::memcmp(&dest[ROW * (ROWS - 1 - y)], &src[ROW * y], ROW), 0 );
+        }
+    }{
+        // padded destination
+        const std::size_t STRIDE = ROW + 64;
+        std::vector<uint8_t> dest(STRIDE * ROWS, 0xcc);
+        sc::CopyEngine::copyRows(
+            dest.data(), (std::ptrdiff_t)STRIDE,
+            src.data(), (std::ptrdiff_t)ROW,
+            ROW, ROWS);
+        for (std::size_t y = 0; y < ROWS; y++)
+        {
+            ASSERT_EQ( std::memcmp(&dest[STRIDE * y], &src[ROW * y], ROW), 0 );
+            ASSERT_EQ( dest[STRIDE * y + ROW], 0xcc );
+        }
+    }{
+        // padded source
+        const std::size_t STRIDE = ROW + 64;
+        auto padded = makePattern(STRIDE * ROWS);
+        std::vector<uint8_t> dest(ROW * ROWS, 0);
+        sc::CopyEngine::copyRows(
+            dest.data(), (std::ptrdiff_t)ROW,
+            padded.data(), (std::ptrdiff_t)STRIDE,
+            ROW, ROWS);
+        for (std::size_t y = 0; y < ROWS; y++)
+        {
+            ASSERT_EQ( std::memcmp(&dest[ROW * y], &padded[STRIDE * y], ROW), 0 );
+        }
+    }{
+        // both bottom-up
+        std::vector<uint8_t> dest(ROW * ROWS, 0);
+        sc::CopyEngine::copyRows(
+            dest.data() + ROW * (ROWS - 1), -(std::ptrdiff_t)ROW,
+            src.data() + ROW * (ROWS - 1), -(std::ptrdiff_t)ROW,
+            ROW, ROWS);
+        EXPECT_EQ( dest, src );
+    }
+}
+
+// Compares the throughput of each method across the range of resolutions
+// that FrameBuffer accepts. Run with --gtest_also_run_disabled_tests.
+TEST(CopyEngine, DISABLED_Benchmark) {
+    const int RESOLUTIONS[][2] = {
+        { 320, 240 }, { 640, 480 }, { 1280, 720 }, { 1920, 1080 },
+        { 2560, 1440 }, { 3840, 2160 }, { 7680, 4320 }, { 16384, 16384 },
+    };
+    const char* NAMES[] = { "memcpy", "sse2", "avx" };
+
+    std::printf("%12s %10s %12s %12s %12s\n", "resolution", "size[MB]", NAMES[0], NAMES[1], NAMES[2]);
+    for (auto& res : RESOLUTIONS)
+    {
+        std::size_t size = (std::size_t)3 * res[0] * res[1];
+        auto src = makePattern(size);
+        std::vector<uint8_t> dest(size, 0);
+        int repeat = (int)std::max<std::size_t>(3, ((std::size_t)1 << 30) / size);
+
+        std::printf("%5dx%-6d %10.2f", res[0], res[1], (double)size / (1 << 20));
+        for (auto method : ALL_METHODS)
+        {
+            if (!sc::CopyEngine::isSupported(method))
+            {
+                std::printf(" %12s", "n/a");
+                continue;
+            }
+            sc::CopyEngine::copy(method, dest.data(), src.data(), size);
+            sc::Timer timer;
+            for (int i = 0; i < repeat; i++)
+            {
+                sc::CopyEngine::copy(method, dest.data(), src.data(), size);
+            }
+            double seconds = timer.get();
+            std::printf(" %7.0fMB/s", (double)size * repeat / (1 << 20) / seconds);
+        }
+        std::printf("\n");
+    }
+}
+
+} //namespace CopyEngineTest
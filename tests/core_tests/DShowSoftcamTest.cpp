@@ -701,6 +701,8 @@ class MediaSampleMock : public CUnknown, public IMediaSample
  public:
     BYTE*       m_ptr;
     std::size_t m_size;
+    REFERENCE_TIME  m_start = -1;
+    REFERENCE_TIME  m_end = -1;
     MediaSampleMock(BYTE* ptr, std::size_t size) :
         CUnknown("", this), m_ptr(ptr), m_size(size)
     {
@@ -723,6 +725,8 @@ class MediaSampleMock : public CUnknown, public IMediaSample
     }
     virtual HRESULT STDMETHODCALLTYPE SetTime(REFERENCE_TIME *pTimeStart, REFERENCE_TIME *pTimeEnd) override
     {
+        m_start = pTimeStart ? *pTimeStart : -1;
+        m_end = pTimeEnd ? *pTimeEnd : -1;
         return S_OK;
     }
     virtual HRESULT STDMETHODCALLTYPE IsSyncPoint() override
@@ -885,6 +889,108 @@ TEST_F(SoftcamStream, CSourceStreamFillBufferNormal)
     th.join();
 }
 
+TEST_F(SoftcamStream, CSourceStreamFillBufferRedeliversLastImage)
+{
+    auto fb = createFrameBufer(320, 240, 60);
+    SetUpSoftcamStream();
+    ASSERT_NE( m_stream, nullptr );
+
+    std::vector<BYTE> input(320 * 240 * 3);
+    for (std::size_t i = 0; i < input.size(); i++)
+    {
+        input[i] = (BYTE)(i % 251);
+    }
+    fb->write(input.data());
+    std::vector<BYTE> first(320 * 240 * 3, 123);
+    MediaSampleMock media_sample1(first.data(), first.size());
+    EXPECT_EQ( m_stream->FillBuffer(&media_sample1), NOERROR );
+
+    // The same image is delivered in another sample after the timeout.
+    std::vector<BYTE> second(320 * 240 * 3, 123);
+    MediaSampleMock media_sample2(second.data(), second.size());
+    EXPECT_EQ( m_stream->FillBuffer(&media_sample2), NOERROR );
+    EXPECT_EQ( second, first );
+
+    // A sample which already holds the image is not written again.
+    std::fill(first.begin(), first.end(), (BYTE)0);
+    EXPECT_EQ( m_stream->FillBuffer(&media_sample1), NOERROR );
+    EXPECT_TRUE( std::all_of(first.begin(), first.end(),
+                             [](BYTE b) { return b == 0; }) );
+    std::copy(second.begin(), second.end(), first.begin());
+
+    // A frame updating a part of the image is delivered as a whole.
+    std::fill(input.begin(), input.end(), (BYTE)7);
+    sc::FrameBuffer::Rect rect = { 100, 100, 10, 10 };
+    fb->writeRegions(input.data(), &rect, 1, sc::Timer::now());
+    EXPECT_EQ( m_stream->FillBuffer(&media_sample1), NOERROR );
+    int error_count = 0;
+    for (int y = 0; y < 240; y++)
+    {
+        for (int x = 0; x < 320; x++)
+        {
+            bool inside = 100 <= x && x < 110 && 100 <= y && y < 110;
+            std::size_t i = 3 * (x + 320 * (239 - y));
+            BYTE expected = inside ? 7 : second[i];
+            error_count += first[i] != expected ? 1 : 0;
+        }
+    }
+    EXPECT_EQ( error_count, 0 );
+}
+
+TEST_F(SoftcamStream, CSourceStreamFillBufferFollowsTimestamps)
+{
+    auto fb = createFrameBufer(320, 240, 0);
+    SetUpSoftcamStream();
+    ASSERT_NE( m_stream, nullptr );
+
+    std::vector<BYTE> input(320 * 240 * 3);
+    std::vector<BYTE> buffer(320 * 240 * 3);
+    MediaSampleMock media_sample(buffer.data(), buffer.size());
+
+    // Timestamps in nanoseconds with irregular intervals.
+    const uint64_t TIMESTAMPS[] = { 5000000000, 5010000000, 5050000000, 5060000000 };
+    REFERENCE_TIME first = 0;
+    for (auto timestamp : TIMESTAMPS)
+    {
+        fb->write(input.data(), timestamp);
+        EXPECT_EQ( m_stream->FillBuffer(&media_sample), NOERROR );
+        if (timestamp == TIMESTAMPS[0])
+        {
+            first = media_sample.m_start;
+        }
+        EXPECT_EQ( media_sample.m_start - first, (REFERENCE_TIME)(timestamp - TIMESTAMPS[0]) / 100 );
+        EXPECT_GT( media_sample.m_end, media_sample.m_start );
+    }
+}
+
+TEST_F(SoftcamStream, CSourceStreamFillBufferAdvancesTimeOfRepeatedFrame)
+{
+    auto fb = createFrameBufer(320, 240, 0);
+    SetUpSoftcamStream();
+    ASSERT_NE( m_stream, nullptr );
+
+    std::vector<BYTE> input(320 * 240 * 3);
+    std::vector<BYTE> buffer(320 * 240 * 3);
+    MediaSampleMock media_sample(buffer.data(), buffer.size());
+
+    fb->write(input.data(), 5000000000);
+    EXPECT_EQ( m_stream->FillBuffer(&media_sample), NOERROR );
+    REFERENCE_TIME start1 = media_sample.m_start;
+
+    // No new frame arrives, and the last one is delivered again after the timeout.
+    EXPECT_EQ( m_stream->FillBuffer(&media_sample), NOERROR );
+    REFERENCE_TIME start2 = media_sample.m_start;
+    EXPECT_GT( start2, start1 );
+    EXPECT_EQ( m_stream->FillBuffer(&media_sample), NOERROR );
+    REFERENCE_TIME start3 = media_sample.m_start;
+    EXPECT_GT( start3, start2 );
+
+    // A frame arriving then starts later than the repeated ones.
+    fb->write(input.data(), 5010000000);
+    EXPECT_EQ( m_stream->FillBuffer(&media_sample), NOERROR );
+    EXPECT_GT( media_sample.m_start, start3 );
+}
+
 TEST_F(SoftcamStream, CSourceStreamGetMediaTypeNoServer)
 {
     SetUpSoftcamStream();
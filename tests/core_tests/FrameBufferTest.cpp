@@ -1,14 +1,39 @@
 #include <softcamcore/FrameBuffer.h>
+#include <softcamcore/InstanceDirectory.h>
 #include <gtest/gtest.h>
 
 #include <vector>
 #include <atomic>
 #include <thread>
+#include <algorithm>
+#include <cstring>
+#if !defined(_WIN32)
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 
 namespace FrameBufferTest {
 namespace sc = softcam;
 
+const char SHMEM_NAME[] = "DirectShow Softcam/SharedMemory";
+const char MUTEX_NAME[] = "DirectShow Softcam/NamedMutex";
+
+// The layout of the shared memory header of version 2 or older
+struct LegacyHeader
+{
+    uint32_t    m_image_offset;
+    uint16_t    m_width;
+    uint16_t    m_height;
+    float       m_framerate;
+    uint8_t     m_is_active;
+    uint8_t     m_connected_min_version;
+    uint8_t     m_watchdog_sender_heartbeat;
+    uint8_t     m_watchdog_receiver_heartbeat;
+    uint64_t    m_frame_counter;
+};
+
 
 TEST(FrameBuffer, Basic1) {
     auto fb = sc::FrameBuffer::create(320, 240, 60);
@@ -133,6 +158,72 @@ TEST(FrameBuffer, MultipleOpenSucceeds) {
     EXPECT_EQ( sender.connected(), true );
 }
 
+TEST(FrameBuffer, NamedInstancesAreIndependent) {
+    auto sender0 = sc::FrameBuffer::create(320, 240, 60);
+    auto sender1 = sc::FrameBuffer::create(640, 480, 30, "fbtest1");
+    auto sender2 = sc::FrameBuffer::create(1280, 720, 0, "fbtest2");
+    ASSERT_TRUE( sender0 );
+    ASSERT_TRUE( sender1 );
+    ASSERT_TRUE( sender2 );
+
+    auto receiver0 = sc::FrameBuffer::open();
+    auto receiver1 = sc::FrameBuffer::open("fbtest1");
+    auto receiver2 = sc::FrameBuffer::open("fbtest2");
+    ASSERT_TRUE( receiver0 );
+    ASSERT_TRUE( receiver1 );
+    ASSERT_TRUE( receiver2 );
+    EXPECT_EQ( receiver0.width(), 320 );
+    EXPECT_EQ( receiver1.width(), 640 );
+    EXPECT_EQ( receiver1.framerate(), 30.0f );
+    EXPECT_EQ( receiver2.width(), 1280 );
+
+    std::vector<uint8_t> image(640 * 480 * 3, 77);
+    sender1.write(image.data());
+    EXPECT_EQ( receiver0.frameCounter(), 0 );
+    EXPECT_EQ( receiver1.frameCounter(), 1 );
+    EXPECT_EQ( receiver2.frameCounter(), 0 );
+}
+
+TEST(FrameBuffer, NamedInstanceIsListedInDirectory) {
+    auto dir = sc::InstanceDirectory::open();
+    {
+        auto sender = sc::FrameBuffer::create(320, 240, 60, "fbtest1");
+        ASSERT_TRUE( sender );
+        EXPECT_TRUE( dir.contains("fbtest1") );
+
+        auto copy = sender;
+        sender.release();
+        EXPECT_TRUE( dir.contains("fbtest1") );
+    }
+    EXPECT_FALSE( dir.contains("fbtest1") );
+    EXPECT_FALSE( sc::FrameBuffer::open("fbtest1") );
+}
+
+TEST(FrameBuffer, NamedInstanceStaysListedWithoutOtherDirectoryHandles) {
+    // No directory handle is held here except the one of the sender itself.
+    auto sender = sc::FrameBuffer::create(320, 240, 60, "fbtest1");
+    ASSERT_TRUE( sender );
+
+    auto receiver = sc::FrameBuffer::open("fbtest1");
+    ASSERT_TRUE( receiver );
+    EXPECT_EQ( receiver.width(), 320 );
+    auto observer = sc::FrameBuffer::observe("fbtest1");
+    EXPECT_TRUE( observer );
+}
+
+TEST(FrameBuffer, NamedInstanceInvalidArgs) {
+    EXPECT_FALSE( sc::FrameBuffer::create(320, 240, 60, "fb/test") );
+    EXPECT_FALSE( sc::FrameBuffer::create(320, 240, 60, "fb\\test") );
+    EXPECT_FALSE( sc::FrameBuffer::create(320, 240, 60, std::string(64, 'a').c_str()) );
+    EXPECT_FALSE( sc::FrameBuffer::open("fbtest1") );
+    EXPECT_FALSE( sc::FrameBuffer::open("fb/test") );
+
+    auto fb1 = sc::FrameBuffer::create(320, 240, 60, "fbtest1");
+    auto fb2 = sc::FrameBuffer::create(320, 240, 60, "fbtest1");
+    EXPECT_TRUE( fb1 );
+    EXPECT_FALSE( fb2 );
+}
+
 TEST(FrameBuffer, CanCopyAssign)
 {
     {
@@ -213,6 +304,575 @@ TEST(FrameBuffer, WriteAndRead) {
     EXPECT_EQ( error_count, 0 );
 }
 
+TEST(FrameBuffer, BottomUpWriteAndRead) {
+    const int W = 1280, H = 720; // large enough for the non-temporal copy
+    auto sender = sc::FrameBuffer::create(W, H, 60, nullptr, true);
+    auto receiver = sc::FrameBuffer::open();
+    ASSERT_TRUE( sender );
+    ASSERT_TRUE( receiver );
+    EXPECT_TRUE( sender.bottomUp() );
+    EXPECT_TRUE( receiver.bottomUp() );
+
+    std::vector<uint8_t> src((std::size_t)W * H * 3);
+    for (int y = 0; y < H; y++)
+    {
+        std::fill_n(src.begin() + (std::size_t)W * 3 * y, W * 3, (uint8_t)y);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        if (i == 0)
+        {
+            sender.write(src.data());
+        }
+        else
+        {
+            // The buffer is exposed from the top row with a negative stride.
+            int stride = 0;
+            uint8_t* image = (uint8_t*)sender.acquireImage(&stride);
+            ASSERT_EQ( stride, -W * 3 );
+            for (int y = 0; y < H; y++)
+            {
+                std::memcpy(image + (std::ptrdiff_t)stride * y, &src[(std::size_t)W * 3 * y], W * 3);
+            }
+            sender.commitImage();
+        }
+
+        std::vector<uint8_t> dest(src.size(), 0);
+        uint64_t frame_counter = 0;
+        receiver.transferToDIB(dest.data(), &frame_counter);
+        EXPECT_EQ( frame_counter, (uint64_t)i + 1 );
+
+        int error_count = 0;
+        for (int y = 0; y < H; y++)
+        {
+            // Bottom to Top
+            auto row = dest.begin() + (std::size_t)W * 3 * (H - 1 - y);
+            error_count += (int)std::count_if(row, row + W * 3, [y](uint8_t v) { return v != (uint8_t)y; });
+        }
+        EXPECT_EQ( error_count, 0 );
+    }
+}
+
+TEST(FrameBuffer, WriteWithStride) {
+    const int W = 320, H = 240;
+    const std::ptrdiff_t ROW = W * 3, STRIDE = ROW + 32;
+    std::vector<uint8_t> padded(STRIDE * H, 0xcc);
+    for (int y = 0; y < H; y++)
+    {
+        std::fill_n(padded.begin() + STRIDE * y, ROW, (uint8_t)y);
+    }
+    for (bool bottom_up : { false, true })
+    {
+        auto sender = sc::FrameBuffer::create(W, H, 60, nullptr, bottom_up);
+        auto receiver = sc::FrameBuffer::open();
+        std::vector<uint8_t> dest(ROW * H);
+        uint64_t frame_counter = 0;
+
+        // Padded rows from the top
+        sender.write(padded.data(), STRIDE, 1);
+        receiver.transferToDIB(dest.data(), &frame_counter);
+        int error_count = 0;
+        for (int y = 0; y < H; y++)
+        {
+            auto row = dest.begin() + ROW * (H - 1 - y);
+            error_count += (int)std::count_if(row, row + ROW, [y](uint8_t v) { return v != (uint8_t)y; });
+        }
+        EXPECT_EQ( error_count, 0 );
+
+        // Padded rows from the bottom with a negative stride
+        sender.write(padded.data() + STRIDE * (H - 1), -STRIDE, 2);
+        receiver.transferToDIB(dest.data(), &frame_counter);
+        EXPECT_EQ( frame_counter, 2 );
+        error_count = 0;
+        for (int y = 0; y < H; y++)
+        {
+            auto row = dest.begin() + ROW * y;
+            error_count += (int)std::count_if(row, row + ROW, [y](uint8_t v) { return v != (uint8_t)y; });
+        }
+        EXPECT_EQ( error_count, 0 );
+    }
+}
+
+TEST(FrameBuffer, WriteRegions) {
+    const int W = 320, H = 240, ROW = W * 3;
+    const sc::FrameBuffer::Rect RECTS[][2] = {
+        { { 0, 0, W, H }, { 0, 0, 0, 0 } },
+        { { 70, 10, 20, 20 }, { 0, 0, 0, 0 } },
+        { { 300, 200, 100, 100 }, { -10, 100, 20, 8 } },
+        { { 64, 64, 128, 64 }, { 70, 60, 10, 10 } },
+        { { 0, 0, 0, 0 }, { 0, 0, 0, 0 } },
+        { { 100, 230, 50, 10 }, { 200, -5, 10, 300 } },
+        { { 130, 20, 1, 1 }, { 0, 0, 0, 0 } },
+    };
+    for (bool bottom_up : { false, true })
+    {
+        auto sender = sc::FrameBuffer::create(W, H, 60, nullptr, bottom_up);
+        auto receiver = sc::FrameBuffer::open();
+        std::vector<uint8_t> expected((std::size_t)ROW * H, 0);
+        int frame = 0;
+        for (auto& rects : RECTS)
+        {
+            // Each frame brings a new value to all pixels, but only those
+            // inside the rectangles should be sent.
+            frame += 1;
+            std::vector<uint8_t> src((std::size_t)ROW * H, (uint8_t)frame);
+            sender.writeRegions(src.data(), rects, 2, frame);
+            for (auto& rect : rects)
+            {
+                for (int y = std::max(rect.y, 0); y < std::min(rect.y + rect.height, H); y++)
+                {
+                    for (int x = std::max(rect.x, 0); x < std::min(rect.x + rect.width, W); x++)
+                    {
+                        std::fill_n(&expected[(std::size_t)ROW * (H - 1 - y) + 3 * x], 3, (uint8_t)frame);
+                    }
+                }
+            }
+            std::vector<uint8_t> dest((std::size_t)ROW * H);
+            uint64_t frame_counter = 0;
+            uint64_t timestamp = 0;
+            receiver.transferToDIB(dest.data(), &frame_counter, &timestamp);
+            EXPECT_EQ( frame_counter, (uint64_t)frame );
+            EXPECT_EQ( timestamp, (uint64_t)frame );
+            EXPECT_TRUE( dest == expected ) << "bottom_up " << bottom_up << " frame " << frame;
+        }
+    }
+}
+
+TEST(FrameBuffer, RefreshDIBCopiesOnlyChangedTiles) {
+    const int W = 320, H = 240, ROW = W * 3;
+    for (bool bottom_up : { false, true })
+    {
+        auto sender = sc::FrameBuffer::create(W, H, 60, nullptr, bottom_up);
+        auto receiver = sc::FrameBuffer::open();
+        std::vector<uint8_t> src((std::size_t)ROW * H, 10);
+        std::vector<uint8_t> dib((std::size_t)ROW * H, 0);
+        auto pixel = [&](int x, int y) { return dib[(std::size_t)ROW * (H - 1 - y) + 3 * x]; };
+
+        // The first refresh copies the whole image.
+        sender.write(src.data(), 1);
+        uint64_t frame_counter = 0;
+        uint64_t timestamp = 0;
+        receiver.refreshDIB(dib.data(), &frame_counter, &timestamp);
+        EXPECT_EQ( frame_counter, 1 );
+        EXPECT_EQ( timestamp, 1 );
+        EXPECT_EQ( std::count(dib.begin(), dib.end(), 10), (std::ptrdiff_t)dib.size() );
+
+        // Mark a tile which won't change, to see that it isn't copied.
+        dib[(std::size_t)ROW * (H - 1 - 200) + 3 * 300] = 99;
+
+        // The tiles changed by two frames are copied at once.
+        std::fill(src.begin(), src.end(), 20);
+        sc::FrameBuffer::Rect rect1 = { 10, 10, 10, 10 };
+        sender.writeRegions(src.data(), &rect1, 1, 2);
+        std::fill(src.begin(), src.end(), 30);
+        sc::FrameBuffer::Rect rect2 = { 130, 70, 10, 10 };
+        sender.writeRegions(src.data(), &rect2, 1, 3);
+        receiver.refreshDIB(dib.data(), &frame_counter, &timestamp);
+        EXPECT_EQ( frame_counter, 3 );
+        EXPECT_EQ( timestamp, 3 );
+        EXPECT_EQ( pixel(10, 10), 20 );
+        EXPECT_EQ( pixel(9, 9), 10 );
+        EXPECT_EQ( pixel(135, 75), 30 );
+        EXPECT_EQ( pixel(300, 200), 99 );
+
+        // Nothing to copy without a new frame.
+        dib[(std::size_t)ROW * (H - 1 - 10) + 3 * 10] = 98;
+        receiver.refreshDIB(dib.data(), &frame_counter, &timestamp);
+        EXPECT_EQ( frame_counter, 3 );
+        EXPECT_EQ( pixel(10, 10), 98 );
+
+        // After more frames than the slots, the whole image is copied.
+        for (int i = 0; i < 4; i++)
+        {
+            sender.writeRegions(src.data(), &rect1, 1, 4 + i);
+        }
+        receiver.refreshDIB(dib.data(), &frame_counter, &timestamp);
+        EXPECT_EQ( frame_counter, 7 );
+        EXPECT_EQ( pixel(10, 10), 30 );
+        EXPECT_EQ( pixel(300, 200), 10 );
+
+        // A frame written entirely makes the whole image dirty.
+        std::fill(src.begin(), src.end(), 40);
+        sender.write(src.data(), 8);
+        receiver.refreshDIB(dib.data(), &frame_counter, &timestamp);
+        EXPECT_EQ( frame_counter, 8 );
+        EXPECT_EQ( std::count(dib.begin(), dib.end(), 40), (std::ptrdiff_t)dib.size() );
+    }
+}
+
+TEST(FrameBuffer, TopDownByDefault) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    EXPECT_FALSE( sender.bottomUp() );
+    EXPECT_FALSE( receiver.bottomUp() );
+
+    int stride = 0;
+    sender.acquireImage(&stride);
+    EXPECT_EQ( stride, 320 * 3 );
+}
+
+TEST(FrameBuffer, ImagesArePageAligned) {
+    auto sender = sc::FrameBuffer::create(324, 240, 60);
+    ASSERT_TRUE( sender );
+
+    for (int i = 0; i < 4; i++)
+    {
+        int stride = 0;
+        void* image = sender.acquireImage(&stride);
+        ASSERT_NE( image, nullptr );
+        EXPECT_EQ( (uintptr_t)image % 4096, 0u );
+        sender.commitImage();
+    }
+}
+
+TEST(FrameBuffer, AcquireAndCommitImage) {
+    auto fb = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+
+    int stride = 0;
+    uint8_t* bits = (uint8_t*)fb.acquireImage(&stride);
+    ASSERT_NE( bits, nullptr );
+    EXPECT_EQ( stride, 320 * 3 );
+    for (int y = 0; y < 240; y++)
+    {
+        std::memset(bits + stride * y, y, 320 * 3);
+    }
+    EXPECT_EQ( fb.frameCounter(), 0 );
+
+    fb.commitImage();
+    EXPECT_EQ( fb.frameCounter(), 1 );
+
+    std::vector<uint8_t> dest(320 * 240 * 3, 0);
+    uint64_t frame_counter = 0;
+    receiver.transferToDIB(dest.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 1 );
+    EXPECT_EQ( dest[0], 239 );
+    EXPECT_EQ( dest[320 * 240 * 3 - 1], 0 );
+
+    fb.commitImage(); // not acquired
+    EXPECT_EQ( fb.frameCounter(), 1 );
+}
+
+TEST(FrameBuffer, FramesCarryTimestamps) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    EXPECT_TRUE( sender.hasTimestamps() );
+    EXPECT_TRUE( receiver.hasTimestamps() );
+
+    std::vector<uint8_t> image(320 * 240 * 3, 0);
+    uint64_t frame_counter = 0, timestamp = 1;
+    sender.write(image.data(), 0);
+    receiver.transferToDIB(image.data(), &frame_counter, &timestamp);
+    EXPECT_EQ( frame_counter, 1 );
+    EXPECT_EQ( timestamp, 0 );
+
+    sender.write(image.data(), 123456789012345);
+    receiver.transferToDIB(image.data(), &frame_counter, &timestamp);
+    EXPECT_EQ( frame_counter, 2 );
+    EXPECT_EQ( timestamp, 123456789012345 );
+
+    // Frames without a timestamp given are stamped with the time they are sent.
+    uint64_t before = sc::Timer::now();
+    int stride = 0;
+    sender.acquireImage(&stride);
+    sender.commitImage();
+    uint64_t after = sc::Timer::now();
+    receiver.transferToDIB(image.data(), &frame_counter, &timestamp);
+    EXPECT_EQ( frame_counter, 3 );
+    EXPECT_GE( timestamp, before );
+    EXPECT_LE( timestamp, after );
+}
+
+TEST(FrameBuffer, StatsCountFrames) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    std::vector<uint8_t> image(320 * 240 * 3, 0);
+    uint64_t frame_counter = 0;
+
+    sender.write(image.data());
+    receiver.transferToDIB(image.data(), &frame_counter);
+    receiver.transferToDIB(image.data(), &frame_counter); // the same frame
+    sender.write(image.data());
+    sender.write(image.data());
+    sender.write(image.data());
+    receiver.transferToDIB(image.data(), &frame_counter);
+
+    sc::FrameBuffer::Stats stats;
+    ASSERT_TRUE( sender.stats(&stats) );
+    EXPECT_EQ( stats.m_frames_written, 4 );
+    EXPECT_EQ( stats.m_mutex_waits, 4 );
+    EXPECT_GE( stats.m_max_mutex_wait_time * 4, stats.m_mutex_wait_time );
+
+    int in_use = 0;
+    for (auto& r : stats.m_receivers)
+    {
+        if (!r.m_in_use) continue;
+        in_use += 1;
+        EXPECT_EQ( r.m_process_id, sc::Process::currentId() );
+        EXPECT_EQ( r.m_frames_read, 2 );
+        EXPECT_EQ( r.m_frames_skipped, 2 );
+        EXPECT_EQ( r.m_frame_counter, 4 );
+        uint32_t total = 0;
+        for (auto count : r.m_latency_histogram)
+        {
+            total += count;
+        }
+        EXPECT_EQ( total, 2 );
+    }
+    EXPECT_EQ( in_use, 1 );
+
+    // The receiver sees the same statistics.
+    sc::FrameBuffer::Stats stats2;
+    ASSERT_TRUE( receiver.stats(&stats2) );
+    EXPECT_EQ( stats2.m_frames_written, 4 );
+}
+
+TEST(FrameBuffer, StatsRecordPacing) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+
+    sender.recordPacing(false, 0);       // the first frame
+    sender.recordPacing(true, 3000);
+    sender.recordPacing(true, 5000);
+    sender.recordPacing(true, -2000);
+    sender.recordPacing(false, 100000);  // a late frame
+    sender.recordJitter(4000, 90000);
+
+    sc::FrameBuffer::Stats stats;
+    ASSERT_TRUE( sender.stats(&stats) );
+    EXPECT_EQ( stats.m_paced_frames, 3 );
+    EXPECT_EQ( stats.m_late_frames, 1 );
+    EXPECT_EQ( stats.m_oversleep, 8000 );
+    EXPECT_EQ( stats.m_max_oversleep, 5000 );
+    EXPECT_EQ( stats.m_undersleep, 2000 );
+    EXPECT_EQ( stats.m_jitter_p50, 4000 );
+    EXPECT_EQ( stats.m_jitter_p99, 90000 );
+}
+
+TEST(FrameBuffer, ObserverIsNotAReceiver) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    std::vector<uint8_t> image(320 * 240 * 3, 0);
+    sender.write(image.data());
+
+    auto observer = sc::FrameBuffer::observe();
+    ASSERT_TRUE( observer );
+    EXPECT_TRUE( observer.readOnly() );
+    EXPECT_EQ( observer.width(), 320 );
+    EXPECT_EQ( observer.height(), 240 );
+    EXPECT_EQ( observer.frameCounter(), 1 );
+
+    // The sender doesn't see the observer as a connected receiver.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_FALSE( sender.connected() );
+
+    sc::FrameBuffer::Stats stats;
+    ASSERT_TRUE( observer.stats(&stats) );
+    EXPECT_EQ( stats.m_frames_written, 1 );
+    EXPECT_EQ( stats.m_sender_process_id, sc::Process::currentId() );
+    for (auto& r : stats.m_receivers)
+    {
+        EXPECT_FALSE( r.m_in_use );
+    }
+
+    // The observer sees receivers connecting later.
+    auto receiver = sc::FrameBuffer::open();
+    uint64_t frame_counter = 0;
+    receiver.transferToDIB(image.data(), &frame_counter);
+    ASSERT_TRUE( observer.stats(&stats) );
+    int in_use = 0;
+    for (auto& r : stats.m_receivers)
+    {
+        if (!r.m_in_use) continue;
+        in_use += 1;
+        EXPECT_EQ( r.m_frames_read, 1 );
+        EXPECT_EQ( r.m_start_time, sc::Process::startTime(sc::Process::currentId()) );
+    }
+    EXPECT_EQ( in_use, 1 );
+}
+
+TEST(FrameBuffer, ObserverDoesntWrite) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto observer = sc::FrameBuffer::observe();
+    ASSERT_TRUE( observer );
+    std::vector<uint8_t> image(320 * 240 * 3, 0);
+
+    observer.write(image.data());
+    EXPECT_EQ( observer.acquireImage(nullptr), nullptr );
+    observer.commitImage();
+    observer.recordPacing(true, 1000);
+    observer.recordJitter(1000, 2000);
+    observer.deactivate();
+
+    EXPECT_EQ( sender.frameCounter(), 0 );
+    EXPECT_TRUE( sender.active() );
+    sc::FrameBuffer::Stats stats;
+    ASSERT_TRUE( sender.stats(&stats) );
+    EXPECT_EQ( stats.m_paced_frames, 0 );
+    EXPECT_EQ( stats.m_jitter_p99, 0 );
+}
+
+TEST(FrameBuffer, ObserveFailsWithoutSender) {
+    auto observer = sc::FrameBuffer::observe();
+    EXPECT_FALSE( observer );
+}
+
+TEST(FrameBuffer, TransferToDIBDoesntWaitForMutex) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    std::vector<uint8_t> src(320 * 240 * 3, 123);
+    std::vector<uint8_t> dest(320 * 240 * 3, 0);
+    sender.write(src.data());
+    sc::NamedMutex mutex(MUTEX_NAME);
+
+    std::atomic<int> pos = 0;
+    mutex.lock();
+    std::thread th([&]{
+        uint64_t frame_counter = 0;
+        receiver.transferToDIB(dest.data(), &frame_counter);
+        EXPECT_EQ( frame_counter, 1 );
+        EXPECT_EQ( dest, src );
+        pos = 1;
+    });
+
+    sc::Timer::sleep(0.1f);
+    EXPECT_EQ( pos, 1 );
+    mutex.unlock();
+    th.join();
+}
+
+TEST(FrameBuffer, TransferToDIBNeverReadsTornImage) {
+    const int NUM_FRAMES = 300;
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+
+    std::atomic<int> done = 0;
+    std::thread th([&]{
+        std::vector<uint8_t> image(320 * 240 * 3);
+        for (int i = 1; i <= NUM_FRAMES; i++)
+        {
+            std::fill(image.begin(), image.end(), (uint8_t)i);
+            sender.write(image.data());
+        }
+        done = 1;
+    });
+
+    std::vector<uint8_t> dest(320 * 240 * 3);
+    int error_count = 0;
+    while (done == 0)
+    {
+        uint64_t frame_counter = 0;
+        receiver.transferToDIB(dest.data(), &frame_counter);
+        uint8_t expected = (uint8_t)frame_counter;
+        if (!std::all_of(dest.begin(), dest.end(), [&](uint8_t v) { return v == expected; }))
+        {
+            error_count += 1;
+        }
+    }
+    th.join();
+    EXPECT_EQ( error_count, 0 );
+    EXPECT_EQ( receiver.frameCounter(), (uint64_t)NUM_FRAMES );
+}
+
+TEST(FrameBuffer, OpenCanReadLegacyLayout) {
+    const uint32_t image_size = 320 * 240 * 3;
+    auto shmem = sc::SharedMemory::create(SHMEM_NAME, sizeof(LegacyHeader) + image_size);
+    ASSERT_TRUE( shmem );
+    LegacyHeader header = {};
+    header.m_image_offset = sizeof(LegacyHeader);
+    header.m_width = 320;
+    header.m_height = 240;
+    header.m_framerate = 30.0f;
+    header.m_is_active = 1;
+    header.m_frame_counter = 5;
+    std::memcpy(shmem.get(), &header, sizeof(header));
+    std::memset((uint8_t*)shmem.get() + sizeof(LegacyHeader), 77, image_size);
+
+    auto receiver = sc::FrameBuffer::open();
+    ASSERT_TRUE( receiver );
+    EXPECT_EQ( receiver.width(), 320 );
+    EXPECT_EQ( receiver.height(), 240 );
+    EXPECT_EQ( receiver.framerate(), 30.0f );
+    EXPECT_EQ( receiver.frameCounter(), 5 );
+    EXPECT_EQ( receiver.active(), true );
+
+    std::vector<uint8_t> dest(image_size, 0);
+    uint64_t frame_counter = 0;
+    uint64_t timestamp = 1;
+    EXPECT_FALSE( receiver.hasTimestamps() );
+    sc::FrameBuffer::Stats stats;
+    EXPECT_FALSE( receiver.stats(&stats) );
+    receiver.transferToDIB(dest.data(), &frame_counter, &timestamp);
+    EXPECT_EQ( frame_counter, 5 );
+    EXPECT_EQ( timestamp, 0 );
+    EXPECT_EQ( dest, std::vector<uint8_t>(image_size, 77) );
+
+    LegacyHeader header2;
+    std::memcpy(&header2, shmem.get(), sizeof(header2));
+    EXPECT_EQ( header2.m_connected_min_version, 3 );
+}
+
+TEST(FrameBuffer, LegacyReceiverCanReadLatestImage) {
+    const uint32_t image_size = 320 * 240 * 3;
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    std::vector<uint8_t> image(image_size, 11);
+    sender.write(image.data());
+    std::fill(image.begin(), image.end(), (uint8_t)22);
+    sender.write(image.data());
+
+    auto shmem = sc::SharedMemory::open(SHMEM_NAME);
+    ASSERT_TRUE( shmem );
+    LegacyHeader header;
+    std::memcpy(&header, shmem.get(), sizeof(header));
+    EXPECT_EQ( header.m_width, 320 );
+    EXPECT_EQ( header.m_height, 240 );
+    EXPECT_EQ( header.m_frame_counter, 2 );
+    ASSERT_GE( shmem.size(), header.m_image_offset + image_size );
+
+    const uint8_t* bits = (const uint8_t*)shmem.get() + header.m_image_offset;
+    EXPECT_TRUE( std::all_of(bits, bits + image_size, [](uint8_t v) { return v == 22; }) );
+}
+
+TEST(FrameBuffer, ReceiversDontWriteToSharedHeartbeat) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto shmem = sc::SharedMemory::open(SHMEM_NAME);
+    ASSERT_TRUE( shmem );
+    auto header = (const LegacyHeader*)shmem.get();
+
+    uint8_t heartbeat = header->m_watchdog_receiver_heartbeat;
+    {
+        // Opened and released repeatedly to see that slots are reused.
+        for (int i = 0; i < 40; i++)
+        {
+            auto receiver = sc::FrameBuffer::open();
+            ASSERT_TRUE( receiver );
+        }
+        auto receiver = sc::FrameBuffer::open();
+        sc::Timer::sleep(sc::FrameBuffer::WATCHDOG_HEARTBEAT_INTERVAL * 5);
+        EXPECT_TRUE( sender.connected() );
+    }
+    EXPECT_EQ( header->m_watchdog_receiver_heartbeat, heartbeat );
+}
+
+TEST(FrameBuffer, MoreReceiversThanSlotsCanConnect) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    {
+        std::vector<sc::FrameBuffer> receivers;
+        for (int i = 0; i < 20; i++)
+        {
+            receivers.push_back(sc::FrameBuffer::open());
+            ASSERT_TRUE( receivers.back() );
+        }
+        sc::Timer::sleep(sc::FrameBuffer::WATCHDOG_TIMEOUT + 0.1f);
+        EXPECT_TRUE( sender.connected() );
+
+        // Only the receivers without a slot are left.
+        receivers.erase(receivers.begin(), receivers.begin() + 16);
+        sc::Timer::sleep(sc::FrameBuffer::WATCHDOG_TIMEOUT + 0.1f);
+        EXPECT_TRUE( sender.connected() );
+    }
+    sc::Timer::sleep(sc::FrameBuffer::WATCHDOG_TIMEOUT + 0.1f);
+    EXPECT_FALSE( sender.connected() );
+}
+
 TEST(FrameBuffer, DeactivateTurnsActiveFlagOff) {
     auto sender = sc::FrameBuffer::create(320, 240, 60);
     auto receiver = sc::FrameBuffer::open();
@@ -229,6 +889,47 @@ TEST(FrameBuffer, DeactivateTurnsActiveFlagOff) {
     EXPECT_EQ( receiver.active(), false );
 }
 
+TEST(FrameBuffer, AccessorsDontWaitForMutex) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    sc::NamedMutex mutex(MUTEX_NAME);
+
+    std::atomic<int> pos = 0;
+    mutex.lock();
+    std::thread th([&]{
+        EXPECT_EQ( receiver.width(), 320 );
+        EXPECT_EQ( receiver.height(), 240 );
+        EXPECT_EQ( receiver.framerate(), 60.0f );
+        EXPECT_EQ( receiver.frameCounter(), 0 );
+        EXPECT_EQ( receiver.active(), true );
+        EXPECT_EQ( sender.connected(), true );
+        pos = 1;
+    });
+
+    sc::Timer::sleep(0.1f);
+    EXPECT_EQ( pos, 1 );
+    mutex.unlock();
+    th.join();
+}
+
+TEST(FrameBuffer, WatchdogsDontWaitForMutex) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    auto shmem = sc::SharedMemory::open(SHMEM_NAME);
+    ASSERT_TRUE( shmem );
+    auto header = (const volatile LegacyHeader*)shmem.get();
+    sc::NamedMutex mutex(MUTEX_NAME);
+
+    // Emulating a peer which holds the mutex longer than the timeout.
+    mutex.lock();
+    uint8_t heartbeat = header->m_watchdog_sender_heartbeat;
+    bool result = receiver.waitForNewFrame(0, sc::FrameBuffer::WATCHDOG_TIMEOUT * 2);
+    EXPECT_EQ( result, true );
+    EXPECT_NE( header->m_watchdog_sender_heartbeat, heartbeat );
+    EXPECT_EQ( sender.connected(), true );
+    mutex.unlock();
+}
+
 TEST(FrameBuffer, WaitForNewFrameTimesOut) {
     const float TIMEOUT_TIME = 0.3f;
     auto fb = sc::FrameBuffer::create(320, 240, 60);
@@ -269,6 +970,39 @@ TEST(FrameBuffer, WaitForNewFrameStopsAfterNewFrameArrived) {
     th.join();
 }
 
+TEST(FrameBuffer, WaitForNewFrameWakesUpPromptly) {
+    const int NUM_FRAMES = 20;
+    auto fb = sc::FrameBuffer::create(320, 240, 60);
+
+    sc::Timer timer;
+    std::atomic<float> write_time = 0.0f;
+    std::atomic<float> max_latency = 0.0f;
+    std::thread th([&]{
+        auto receiver = sc::FrameBuffer::open();
+        for (int i = 0; i < NUM_FRAMES; i++)
+        {
+            bool ret = receiver.waitForNewFrame(i, 2.0f);
+            float latency = timer.get() - write_time;
+            EXPECT_EQ( ret, true );
+            EXPECT_GT( receiver.frameCounter(), (uint64_t)i );
+            max_latency = std::max(max_latency.load(), latency);
+        }
+    });
+
+    EXPECT_TRUE( fb.waitForConnection(2.0f) );
+    std::vector<uint8_t> image(320 * 240 * 3, 255);
+    for (int i = 0; i < NUM_FRAMES; i++)
+    {
+        sc::Timer::sleep(0.01f);
+        write_time = timer.get();
+        fb.write(image.data());
+    }
+    th.join();
+
+    // Much shorter than the watchdog interval, which bounds a polling wait.
+    EXPECT_LT( max_latency.load(), sc::FrameBuffer::WATCHDOG_MONITOR_INTERVAL / 2 );
+}
+
 TEST(FrameBuffer, WaitForNewFrameStopsWhenDeactivated) {
     const float TIMEOUT_TIME = 2.0f;
     auto fb = sc::FrameBuffer::create(320, 240, 60);
@@ -363,4 +1097,187 @@ TEST(FrameBuffer, SenderDetectsReceiversDisconnection) {
     EXPECT_FALSE( sender.connected() );
 }
 
+#if !defined(_WIN32)
+
+// The child process runs the function and then waits to be killed,
+// so that the caller can emulate an abnormal termination.
+// Forking before creating any frame buffer keeps the child free of
+// the watchdog threads of the parent.
+pid_t forkPeer(int* out_ready_fd, bool (*func)())
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        char ready = func() ? 1 : 0;
+        if (write(fds[1], &ready, 1) != 1 || !ready)
+        {
+            _exit(1);
+        }
+        for (;;)
+        {
+            pause();
+        }
+    }
+    close(fds[1]);
+    *out_ready_fd = fds[0];
+    return pid;
+}
+
+bool waitForPeer(int ready_fd)
+{
+    char ready = 0;
+    bool ok = read(ready_fd, &ready, 1) == 1 && ready == 1;
+    close(ready_fd);
+    return ok;
+}
+
+TEST(FrameBuffer, ReceiverDetectsSenderCrashPromptly) {
+    int ready_fd = -1;
+    pid_t pid = forkPeer(&ready_fd, []
+    {
+        static std::vector<sc::FrameBuffer> senders;
+        senders.push_back(sc::FrameBuffer::create(320, 240, 60));
+        return (bool)senders.back();
+    });
+    ASSERT_GT( pid, 0 );
+    ASSERT_TRUE( waitForPeer(ready_fd) );
+
+    auto receiver = sc::FrameBuffer::open();
+    ASSERT_TRUE( receiver );
+    EXPECT_TRUE( receiver.waitForNewFrame(0, 0.1f) );
+
+    kill(pid, SIGKILL);
+    sc::Timer timer;
+    EXPECT_FALSE( receiver.waitForNewFrame(0, 0.0f) );
+    EXPECT_LT( timer.get(), sc::FrameBuffer::WATCHDOG_TIMEOUT / 2 );
+    waitpid(pid, nullptr, 0);
+    receiver.release();
+
+    // The shared memory left behind doesn't prevent a new sender.
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    EXPECT_TRUE( sender );
+}
+
+TEST(FrameBuffer, SenderDetectsReceiverCrashPromptly) {
+    int ready_fd = -1;
+    pid_t pid = forkPeer(&ready_fd, []
+    {
+        static std::vector<sc::FrameBuffer> receivers;
+        for (int i = 0; i < 500; i++)
+        {
+            auto receiver = sc::FrameBuffer::open();
+            if (receiver)
+            {
+                receivers.push_back(receiver);
+                return true;
+            }
+            sc::Timer::sleep(0.01f);
+        }
+        return false;
+    });
+    ASSERT_GT( pid, 0 );
+
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    ASSERT_TRUE( sender );
+    ASSERT_TRUE( waitForPeer(ready_fd) );
+    EXPECT_TRUE( sender.connected() );
+
+    kill(pid, SIGKILL);
+    sc::Timer timer;
+    while (sender.connected() && timer.get() < sc::FrameBuffer::WATCHDOG_TIMEOUT * 2)
+    {
+        sc::Timer::sleep(0.001f);
+    }
+    EXPECT_FALSE( sender.connected() );
+    EXPECT_LT( timer.get(), sc::FrameBuffer::WATCHDOG_TIMEOUT / 2 );
+    waitpid(pid, nullptr, 0);
+}
+
+TEST(FrameBuffer, StalledReceiverDoesntFreeReclaimedSlot) {
+    int ready_fd = -1;
+    pid_t pid = forkPeer(&ready_fd, []
+    {
+        static std::vector<sc::FrameBuffer> receivers;
+        for (int i = 0; i < 500; i++)
+        {
+            auto receiver = sc::FrameBuffer::open();
+            if (receiver)
+            {
+                receivers.push_back(receiver);
+                // Releases the receiver after the parent resumes us.
+                std::thread([]
+                {
+                    std::this_thread::sleep_for(std::chrono::seconds(2));
+                    receivers.clear();
+                    _exit(0);
+                }).detach();
+                return true;
+            }
+            sc::Timer::sleep(0.01f);
+        }
+        return false;
+    });
+    ASSERT_GT( pid, 0 );
+
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    ASSERT_TRUE( sender );
+    ASSERT_TRUE( waitForPeer(ready_fd) );
+
+    // The sender reclaims the slot of the stalled receiver.
+    kill(pid, SIGSTOP);
+    auto slots_in_use = [&]
+    {
+        sc::FrameBuffer::Stats stats;
+        int count = 0;
+        if (sender.stats(&stats))
+        {
+            for (auto& r : stats.m_receivers)
+            {
+                count += r.m_in_use ? 1 : 0;
+            }
+        }
+        return count;
+    };
+    sc::Timer timer;
+    while (slots_in_use() != 0 && timer.get() < sc::FrameBuffer::WATCHDOG_TIMEOUT * 6)
+    {
+        sc::Timer::sleep(0.01f);
+    }
+    ASSERT_EQ( slots_in_use(), 0 );
+
+    // Another receiver takes the slot, and the resumed one releases its own.
+    auto receiver = sc::FrameBuffer::open();
+    ASSERT_TRUE( receiver );
+    EXPECT_EQ( slots_in_use(), 1 );
+    kill(pid, SIGCONT);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE( WIFEXITED(status) );
+
+    std::this_thread::sleep_for(std::chrono::milliseconds((int)(sc::FrameBuffer::WATCHDOG_TIMEOUT * 2000)));
+    EXPECT_EQ( slots_in_use(), 1 );
+    EXPECT_TRUE( sender.connected() );
+
+    std::vector<uint8_t> image(320 * 240 * 3, 0);
+    uint64_t frame_counter = 0;
+    sender.write(image.data());
+    receiver.transferToDIB(image.data(), &frame_counter);
+    sc::FrameBuffer::Stats stats;
+    ASSERT_TRUE( sender.stats(&stats) );
+    for (auto& r : stats.m_receivers)
+    {
+        if (!r.m_in_use) continue;
+        EXPECT_EQ( r.m_process_id, sc::Process::currentId() );
+        EXPECT_EQ( r.m_frames_read, 1 );
+    }
+}
+
+#endif
+
 } //namespace FrameBufferTest
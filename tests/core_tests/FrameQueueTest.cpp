@@ -0,0 +1,139 @@
+#include <softcamcore/FrameQueue.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <softcamcore/Misc.h>
+
+
+namespace FrameQueueTest {
+namespace sc = softcam;
+
+#define SLEEP_MS(msec) \
+        std::this_thread::sleep_for(std::chrono::milliseconds(msec))
+
+const std::size_t FRAME_SIZE = 320 * 240 * 3;
+
+// A deliver function which takes the given time and records the first
+// byte and the timestamp of each frame.
+struct Recorder
+{
+    std::mutex                  m_mutex;
+    std::vector<int>            m_delivered;
+    std::vector<std::uint64_t>  m_timestamps;
+    std::atomic<int>            m_delay_ms{ 0 };
+
+    sc::FrameQueue::Deliver deliver()
+    {
+        return [this](const void* bits, std::uint64_t timestamp)
+        {
+            SLEEP_MS(m_delay_ms.load());
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_delivered.push_back(*static_cast<const unsigned char*>(bits));
+            m_timestamps.push_back(timestamp);
+        };
+    }
+    std::vector<int> delivered()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_delivered;
+    }
+};
+
+
+TEST(FrameQueue, DeliversFramesInOrder) {
+    Recorder rec;
+    sc::FrameQueue queue(FRAME_SIZE, 3, sc::FrameQueue::OVERFLOW_BLOCK, rec.deliver());
+    std::vector<unsigned char> image(FRAME_SIZE);
+
+    for (int i = 0; i < 10; i++)
+    {
+        image[0] = (unsigned char)i;
+        queue.push(image.data(), 1000 + i);
+    }
+    queue.flush();
+
+    EXPECT_EQ( rec.delivered(), (std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }) );
+    EXPECT_EQ( rec.m_timestamps.front(), 1000 );
+    EXPECT_EQ( rec.m_timestamps.back(), 1009 );
+    EXPECT_EQ( queue.depth(), 0 );
+    EXPECT_EQ( queue.dropped(), 0 );
+}
+
+TEST(FrameQueue, PushCopiesTheFrame) {
+    Recorder rec;
+    rec.m_delay_ms = 20;
+    sc::FrameQueue queue(FRAME_SIZE, 3, sc::FrameQueue::OVERFLOW_BLOCK, rec.deliver());
+    std::vector<unsigned char> image(FRAME_SIZE);
+
+    image[0] = 1;
+    queue.push(image.data(), 0);
+    image[0] = 2; // the caller may reuse the image right away
+    queue.flush();
+
+    EXPECT_EQ( rec.delivered(), (std::vector<int>{ 1 }) );
+}
+
+TEST(FrameQueue, DropOldestDoesntBlock) {
+    Recorder rec;
+    rec.m_delay_ms = 50;
+    sc::FrameQueue queue(FRAME_SIZE, 2, sc::FrameQueue::OVERFLOW_DROP_OLDEST, rec.deliver());
+    std::vector<unsigned char> image(FRAME_SIZE);
+
+    image[0] = 0;
+    queue.push(image.data(), 0);
+    SLEEP_MS(10); // let the thread take the first frame
+
+    sc::Timer timer;
+    for (int i = 1; i < 6; i++)
+    {
+        image[0] = (unsigned char)i;
+        queue.push(image.data(), 0);
+    }
+    EXPECT_LT( timer.get(), 0.02f );
+    EXPECT_EQ( queue.depth(), 3 );
+    EXPECT_EQ( queue.dropped(), 3 );
+
+    queue.flush();
+    EXPECT_EQ( rec.delivered(), (std::vector<int>{ 0, 4, 5 }) );
+}
+
+TEST(FrameQueue, BlockWaitsForRoom) {
+    Recorder rec;
+    rec.m_delay_ms = 30;
+    sc::FrameQueue queue(FRAME_SIZE, 1, sc::FrameQueue::OVERFLOW_BLOCK, rec.deliver());
+    std::vector<unsigned char> image(FRAME_SIZE);
+
+    queue.push(image.data(), 0);
+    SLEEP_MS(10); // let the thread take the first frame
+    queue.push(image.data(), 0);
+    EXPECT_EQ( queue.depth(), 2 );
+
+    sc::Timer timer;
+    queue.push(image.data(), 0);
+    EXPECT_GT( timer.get(), 0.01f );
+    EXPECT_EQ( queue.dropped(), 0 );
+
+    queue.flush();
+    EXPECT_EQ( rec.delivered().size(), 3 );
+}
+
+TEST(FrameQueue, DestructorDiscardsPendingFrames) {
+    Recorder rec;
+    rec.m_delay_ms = 30;
+    {
+        sc::FrameQueue queue(FRAME_SIZE, 3, sc::FrameQueue::OVERFLOW_BLOCK, rec.deliver());
+        std::vector<unsigned char> image(FRAME_SIZE);
+
+        for (int i = 0; i < 3; i++)
+        {
+            queue.push(image.data(), 0);
+        }
+        SLEEP_MS(10);
+    }
+    EXPECT_EQ( rec.delivered().size(), 1 );
+}
+
+} //namespace FrameQueueTest
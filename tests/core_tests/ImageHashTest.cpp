@@ -0,0 +1,105 @@
+#include <softcamcore/ImageHash.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+
+namespace ImageHashTest {
+namespace sc = softcam;
+
+const sc::ImageHash::Method ALL_METHODS[] = {
+    sc::ImageHash::METHOD_SCALAR,
+    sc::ImageHash::METHOD_SSE2,
+};
+
+std::vector<uint8_t> makePattern(std::size_t size)
+{
+    std::vector<uint8_t> data(size);
+    for (std::size_t i = 0; i < size; i++)
+    {
+        data[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    return data;
+}
+
+TEST(ImageHash, ScalarIsAlwaysSupported) {
+    EXPECT_TRUE( sc::ImageHash::isSupported(sc::ImageHash::METHOD_SCALAR) );
+    EXPECT_TRUE( sc::ImageHash::isSupported(sc::ImageHash::bestMethod()) );
+}
+
+TEST(ImageHash, AllMethodsGiveTheSameHash) {
+    const std::size_t ROW_SIZES[] = { 0, 1, 12, 16, 17, 960, 3 * 324 };
+    for (auto row_size : ROW_SIZES)
+    {
+        auto data = makePattern((row_size + 5) * 10);
+        auto expected = sc::ImageHash::hashRows(
+                sc::ImageHash::METHOD_SCALAR, data.data(), row_size + 5, row_size, 10);
+        for (auto method : ALL_METHODS)
+        {
+            EXPECT_EQ( sc::ImageHash::hashRows(method, data.data(), row_size + 5, row_size, 10), expected )
+                << "method=" << method << " row_size=" << row_size;
+        }
+    }
+}
+
+TEST(ImageHash, IgnoresPaddingAndFollowsStride) {
+    const std::size_t W = 324, H = 20, ROW = W * 3, STRIDE = ROW + 20;
+    auto packed = makePattern(ROW * H);
+    std::vector<uint8_t> padded(STRIDE * H, 0xcc);
+    std::vector<uint8_t> bottom_up(ROW * H);
+    for (std::size_t y = 0; y < H; y++)
+    {
+        std::copy_n(&packed[ROW * y], ROW, &padded[STRIDE * y]);
+        std::copy_n(&packed[ROW * y], ROW, &bottom_up[ROW * (H - 1 - y)]);
+    }
+    auto expected = sc::ImageHash::hashRows(packed.data(), ROW, ROW, H);
+    EXPECT_EQ( sc::ImageHash::hashRows(padded.data(), STRIDE, ROW, H), expected );
+    EXPECT_EQ( sc::ImageHash::hashRows(&bottom_up[ROW * (H - 1)], -(std::ptrdiff_t)ROW, ROW, H), expected );
+
+    std::fill(padded.begin(), padded.end(), 0x33);
+    for (std::size_t y = 0; y < H; y++)
+    {
+        std::copy_n(&packed[ROW * y], ROW, &padded[STRIDE * y]);
+    }
+    EXPECT_EQ( sc::ImageHash::hashRows(padded.data(), STRIDE, ROW, H), expected );
+}
+
+TEST(ImageHash, DetectsChanges) {
+    const std::size_t SIZE = 320 * 240 * 3;
+    for (auto method : ALL_METHODS)
+    {
+        auto data = makePattern(SIZE);
+        auto hash = [&] { return sc::ImageHash::hashRows(method, data.data(), SIZE, SIZE, 1); };
+        const auto original = hash();
+        EXPECT_EQ( hash(), original );
+
+        // A single bit anywhere
+        for (std::size_t i : { (std::size_t)0, (std::size_t)7, (std::size_t)8, (std::size_t)15,
+                               SIZE / 2, SIZE - 1 })
+        {
+            for (int bit = 0; bit < 8; bit++)
+            {
+                data[i] ^= (uint8_t)(1 << bit);
+                EXPECT_NE( hash(), original ) << "method=" << method << " i=" << i << " bit=" << bit;
+                data[i] ^= (uint8_t)(1 << bit);
+            }
+        }
+
+        // A block moved to another place
+        std::swap_ranges(data.begin(), data.begin() + 16, data.begin() + 1600);
+        EXPECT_NE( hash(), original ) << "method=" << method;
+        std::swap_ranges(data.begin(), data.begin() + 16, data.begin() + 1600);
+
+        // A different size
+        EXPECT_NE( sc::ImageHash::hashRows(method, data.data(), SIZE - 1, SIZE - 1, 1), original );
+
+        // Blank images of different sizes
+        std::vector<uint8_t> blank(SIZE, 0);
+        EXPECT_NE( sc::ImageHash::hashRows(method, blank.data(), 960, 960, 240),
+                   sc::ImageHash::hashRows(method, blank.data(), 960, 960, 239) );
+    }
+}
+
+} //namespace ImageHashTest
@@ -0,0 +1,117 @@
+#include <softcamcore/InstanceDirectory.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+namespace InstanceDirectoryTest {
+namespace sc = softcam;
+
+bool listContains(const std::vector<std::string>& names, const char* name)
+{
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+TEST(InstanceDirectory, Basic) {
+    auto dir = sc::InstanceDirectory::open();
+    ASSERT_TRUE( dir );
+
+    EXPECT_FALSE( dir.contains("dirtest1") );
+    EXPECT_TRUE( dir.add("dirtest1") );
+    EXPECT_TRUE( dir.contains("dirtest1") );
+    EXPECT_TRUE( listContains(dir.list(), "dirtest1") );
+
+    dir.remove("dirtest1");
+    EXPECT_FALSE( dir.contains("dirtest1") );
+    EXPECT_FALSE( listContains(dir.list(), "dirtest1") );
+}
+
+TEST(InstanceDirectory, SharedBetweenInstances) {
+    auto dir1 = sc::InstanceDirectory::open();
+    auto dir2 = sc::InstanceDirectory::open();
+
+    EXPECT_TRUE( dir1.add("dirtest1") );
+    EXPECT_TRUE( dir2.contains("dirtest1") );
+    EXPECT_TRUE( listContains(dir2.list(), "dirtest1") );
+
+    dir2.remove("dirtest1");
+    EXPECT_FALSE( dir1.contains("dirtest1") );
+}
+
+TEST(InstanceDirectory, AddingTwiceKeepsOneEntry) {
+    auto dir = sc::InstanceDirectory::open();
+
+    EXPECT_TRUE( dir.add("dirtest1") );
+    EXPECT_TRUE( dir.add("dirtest1") );
+    auto names = dir.list();
+    EXPECT_EQ( std::count(names.begin(), names.end(), "dirtest1"), 1 );
+
+    dir.remove("dirtest1");
+    EXPECT_FALSE( dir.contains("dirtest1") );
+}
+
+TEST(InstanceDirectory, FindsEntriesAfterRemoval) {
+    auto dir = sc::InstanceDirectory::open();
+
+    std::vector<std::string> names;
+    for (int i = 0; i < 10; i++)
+    {
+        names.push_back("dirtest_" + std::to_string(i));
+        EXPECT_TRUE( dir.add(names.back().c_str()) );
+    }
+    for (int i = 0; i < 10; i += 2)
+    {
+        dir.remove(names[i].c_str());
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ( dir.contains(names[i].c_str()), i % 2 == 1 );
+    }
+    for (int i = 1; i < 10; i += 2)
+    {
+        dir.remove(names[i].c_str());
+    }
+}
+
+TEST(InstanceDirectory, CapacityIsLimited) {
+    auto dir = sc::InstanceDirectory::open();
+    auto existing = dir.list().size();
+
+    std::vector<std::string> names;
+    for (int i = 0; i < sc::InstanceDirectory::MAX_INSTANCES + 1; i++)
+    {
+        names.push_back("dirtest_" + std::to_string(i));
+    }
+    int added = 0;
+    for (auto& name : names)
+    {
+        added += dir.add(name.c_str()) ? 1 : 0;
+    }
+    EXPECT_EQ( added, sc::InstanceDirectory::MAX_INSTANCES - (int)existing );
+    for (auto& name : names)
+    {
+        dir.remove(name.c_str());
+    }
+    EXPECT_EQ( dir.list().size(), existing );
+}
+
+TEST(InstanceDirectory, InvalidNames) {
+    auto dir = sc::InstanceDirectory::open();
+
+    EXPECT_FALSE( sc::InstanceDirectory::isValidName(nullptr) );
+    EXPECT_FALSE( sc::InstanceDirectory::isValidName("") );
+    EXPECT_FALSE( sc::InstanceDirectory::isValidName("a/b") );
+    EXPECT_FALSE( sc::InstanceDirectory::isValidName("a\\b") );
+    EXPECT_FALSE( sc::InstanceDirectory::isValidName(std::string(64, 'a').c_str()) );
+    EXPECT_TRUE( sc::InstanceDirectory::isValidName(std::string(63, 'a').c_str()) );
+
+    EXPECT_FALSE( dir.add(nullptr) );
+    EXPECT_FALSE( dir.add("") );
+    EXPECT_FALSE( dir.add("a/b") );
+    EXPECT_FALSE( dir.contains(nullptr) );
+    EXPECT_NO_THROW({ dir.remove(nullptr); });
+}
+
+} //namespace InstanceDirectoryTest
@@ -5,6 +5,17 @@
 #include <thread>
 #include <atomic>
 #include <cmath>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 
 namespace MiscTest {
@@ -12,11 +23,30 @@ namespace sc = softcam;
 
 const char SHMEM_NAME[] = "shmemtest";
 const char MUTEX_NAME[] = "shmemtest_mutex";
+const char EVENT_NAME[] = "shmemtest_event";
 const char ANOTHER_NAME[] = "shmemtest2";
 const unsigned long SHMEM_SIZE = 888;
 const char SOME_DATA[] = "Hello, world!";
 const char ANOTHER_DATA[] = "12345";
 
+// The CPU time consumed by the calling thread in seconds.
+double threadCpuTime()
+{
+    #if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    auto toSeconds = [](const FILETIME& t)
+    {
+        return (double)(((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) * 1e-7;
+    };
+    return toSeconds(kernel) + toSeconds(user);
+    #else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+    #endif
+}
+
 #define WAIT_FOR(expr) [&]{ \
             while (!(expr)) { sc::Timer::sleep(0.01f); } \
         }()
@@ -64,6 +94,87 @@ TEST(Timer, SleepAccuracy) {
     EXPECT_LT( std::sqrt(variance), 0.003f );
 }
 
+TEST(Timer, SleepUntilAccuracy) {
+    const int REPEAT = 20;
+
+    std::vector<float> errors;
+    for (int i = 0; i < REPEAT; i++)
+    {
+        const float expected = (float)(i % 10) * 0.0023f;
+
+        sc::Timer timer;
+        sc::Timer::sleepUntil(sc::Timer::now() + (uint64_t)(expected * 1e9f));
+        float actual = timer.get();
+
+        float error = actual - expected;
+        EXPECT_GE( error, 0.0f );
+        errors.push_back(error);
+    }
+
+    // The spin at the end makes it far more precise than sleep(), which
+    // may be off by a millisecond. The median ignores a few wakeups
+    // delayed by preemption on a loaded machine.
+    std::sort(errors.begin(), errors.end());
+    EXPECT_LT( errors[REPEAT / 2], 0.0002f );
+    EXPECT_LT( errors[REPEAT * 3 / 4], 0.0005f );
+}
+
+// Compares the accuracy and the CPU time of sleep() and sleepUntil().
+// Run with --gtest_also_run_disabled_tests.
+TEST(Timer, DISABLED_SleepBenchmark) {
+    const float DURATIONS[] = { 0.0005f, 0.001f, 0.0042f, 0.0167f };
+    const int REPEAT = 100;
+
+    std::printf("%10s %8s %12s %12s %10s\n", "method", "sleep[ms]", "p50[us]", "p99[us]", "cpu[%]");
+    for (int method = 0; method < 2; method++)
+    {
+        for (auto duration : DURATIONS)
+        {
+            std::vector<float> errors;
+            double cpu_start = threadCpuTime();
+            sc::Timer total;
+            for (int i = 0; i < REPEAT; i++)
+            {
+                sc::Timer timer;
+                if (method == 0)
+                {
+                    sc::Timer::sleep(duration);
+                }
+                else
+                {
+                    sc::Timer::sleepUntil(sc::Timer::now() + (uint64_t)(duration * 1e9f));
+                }
+                errors.push_back(std::fabs(timer.get() - duration));
+            }
+            double cpu = (threadCpuTime() - cpu_start) / total.get();
+            std::sort(errors.begin(), errors.end());
+            std::printf("%10s %8.1f %12.1f %12.1f %10.1f\n",
+                method == 0 ? "sleep" : "sleepUntil",
+                duration * 1e3f,
+                errors[REPEAT / 2] * 1e6f,
+                errors[REPEAT * 99 / 100] * 1e6f,
+                cpu * 100.0);
+        }
+    }
+}
+
+TEST(Timer, NowAndSleepUntil) {
+    auto t1 = sc::Timer::now();
+    sc::Timer timer;
+    sc::Timer::sleepUntil(t1 + 20000000);
+    auto t2 = sc::Timer::now();
+    auto elapsed = timer.get();
+
+    EXPECT_GE( t2, t1 + 20000000 );
+    EXPECT_LT( t2, t1 + 40000000 );
+    EXPECT_NEAR( elapsed, (float)(t2 - t1) * 1e-9f, 0.002f );
+
+    // A time in the past returns immediately.
+    timer.reset();
+    sc::Timer::sleepUntil(t1);
+    EXPECT_LT( timer.get(), 0.002f );
+}
+
 TEST(Timer, Rewind) {
     sc::Timer timer;
     EXPECT_NO_THROW({ timer.rewind(0.2f); });
@@ -117,6 +228,148 @@ TEST(NamedMutex, Basic)
     th2.join();
 }
 
+TEST(NamedMutex, Recursive)
+{
+    std::atomic<int> signal = 0;
+
+    std::thread th1([&]
+    {
+        sc::NamedMutex mutex(MUTEX_NAME);
+        mutex.lock();
+        mutex.lock();
+        mutex.unlock();
+        signal = 1;
+        WAIT_FOR( signal >= 3 );
+        mutex.unlock();
+    });
+    std::thread th2([&]
+    {
+        sc::NamedMutex mutex(MUTEX_NAME);
+        WAIT_FOR( signal >= 2 );
+        mutex.lock();
+        signal = 4;
+        mutex.unlock();
+    });
+
+    // The inner unlock doesn't release the lock.
+    WAIT_FOR( signal >= 1 );
+    signal = 2;
+    sc::Timer::sleep(0.1f);
+    EXPECT_EQ( signal.load(), 2 );
+    signal = 3;
+    WAIT_FOR( signal >= 4 );
+    EXPECT_EQ( signal.load(), 4 );
+
+    th1.join();
+    th2.join();
+}
+
+#if !defined(_WIN32)
+TEST(NamedMutex, RecoversFromCreatorTerminatedHalfway)
+{
+    const char NAME[] = "shmemtest_stale_mutex";
+    const char POSIX_NAME[] = "/shmemtest_stale_mutex";
+
+    // The creator has terminated before extending the object,
+    // and then before initializing the mutex.
+    for (off_t size : { (off_t)0, (off_t)4096 })
+    {
+        shm_unlink(POSIX_NAME);
+        int fd = shm_open(POSIX_NAME, O_RDWR | O_CREAT | O_EXCL, 0600);
+        ASSERT_GE( fd, 0 );
+        ASSERT_EQ( ftruncate(fd, size), 0 );
+        close(fd);
+
+        sc::Timer timer;
+        sc::NamedMutex mutex1(NAME);
+        sc::NamedMutex mutex2(NAME);
+        EXPECT_LT( timer.get(), 0.5f );
+
+        std::atomic<int> signal = 0;
+        mutex1.lock();
+        std::thread th([&]
+        {
+            mutex2.lock();
+            signal = 1;
+            mutex2.unlock();
+        });
+        sc::Timer::sleep(0.05f);
+        EXPECT_EQ( signal.load(), 0 );
+        mutex1.unlock();
+        th.join();
+        EXPECT_EQ( signal.load(), 1 );
+    }
+    shm_unlink(POSIX_NAME);
+}
+#endif
+
+TEST(NamedEvent, Basic)
+{
+    sc::NamedEvent event1(EVENT_NAME);
+    sc::NamedEvent event2(EVENT_NAME);
+
+    auto seq = event1.sequence();
+    EXPECT_EQ( event2.sequence(), seq );
+
+    event2.notify();
+
+    EXPECT_NE( event1.sequence(), seq );
+    EXPECT_EQ( event1.sequence(), event2.sequence() );
+}
+
+TEST(NamedEvent, WaitReturnsImmediatelyIfAlreadyNotified)
+{
+    sc::NamedEvent event(EVENT_NAME);
+
+    auto seq = event.sequence();
+    event.notify();
+
+    sc::Timer timer;
+    EXPECT_TRUE( event.wait(seq, 1.0f) );
+    EXPECT_LT( timer.get(), 0.1f );
+}
+
+TEST(NamedEvent, WaitTimeout)
+{
+    sc::NamedEvent event(EVENT_NAME);
+
+    auto seq = event.sequence();
+
+    sc::Timer timer;
+    EXPECT_FALSE( event.wait(seq, 0.1f) );
+    EXPECT_GE( timer.get(), 0.09f );
+    EXPECT_LT( timer.get(), 0.5f );
+}
+
+TEST(NamedEvent, WakesUpAllWaiters)
+{
+    std::atomic<int> woken = 0;
+    sc::NamedEvent event(EVENT_NAME);
+    auto seq = event.sequence();
+
+    std::thread th1([&]
+    {
+        sc::NamedEvent event(EVENT_NAME);
+        if (event.wait(seq, 10.0f)) woken++;
+    });
+    std::thread th2([&]
+    {
+        sc::NamedEvent event(EVENT_NAME);
+        if (event.wait(seq, 10.0f)) woken++;
+    });
+
+    sc::Timer::sleep(0.1f);
+    EXPECT_EQ( woken.load(), 0 );
+
+    sc::Timer timer;
+    event.notify();
+    th1.join();
+    th2.join();
+
+    EXPECT_EQ( woken.load(), 2 );
+    EXPECT_LT( timer.get(), 0.5f );
+}
+
 TEST(SharedMemory, Basic1) {
     auto shmem = sc::SharedMemory::create(SHMEM_NAME, SHMEM_SIZE);
 
@@ -157,6 +410,24 @@ TEST(SharedMemory, Basic3) {
     mutex.unlock();
 }
 
+TEST(SharedMemory, OpenReadOnly) {
+    auto view1 = sc::SharedMemory::create(SHMEM_NAME, SHMEM_SIZE);
+    ASSERT_TRUE( view1 );
+    std::memcpy(view1.get(), SOME_DATA, sizeof(SOME_DATA));
+
+    auto view2 = sc::SharedMemory::openReadOnly(SHMEM_NAME);
+    ASSERT_TRUE( view2 );
+    EXPECT_GE( view2.size(), SHMEM_SIZE );
+    EXPECT_EQ( std::memcmp(view2.get(), SOME_DATA, sizeof(SOME_DATA)), 0 );
+
+    // Releasing the read-only view leaves the object as it is.
+    view2 = sc::SharedMemory{};
+    auto view3 = sc::SharedMemory::open(SHMEM_NAME);
+    EXPECT_TRUE( view3 );
+
+    EXPECT_FALSE( sc::SharedMemory::openReadOnly(ANOTHER_NAME) );
+}
+
 TEST(SharedMemory, InvalidArgs) {
     {
         auto shmem = sc::SharedMemory::create(SHMEM_NAME, 0);
@@ -218,4 +489,31 @@ TEST(SharedMemory, MultipleOpenSucceeds) {
     EXPECT_GE( view3.size(), SHMEM_SIZE );
 }
 
+TEST(Process, CurrentProcessIsAlive) {
+    auto id = sc::Process::currentId();
+    auto start_time = sc::Process::startTime(id);
+
+    EXPECT_NE( id, 0u );
+    EXPECT_NE( start_time, 0u );
+    EXPECT_EQ( sc::Process::startTime(id), start_time );
+    EXPECT_TRUE( sc::Process::isAlive(id, start_time) );
+    EXPECT_TRUE( sc::Process::isAlive(id, 0) );
+}
+
+TEST(Process, ReusedIdIsNotAlive) {
+    auto id = sc::Process::currentId();
+    auto start_time = sc::Process::startTime(id);
+
+    EXPECT_FALSE( sc::Process::isAlive(id, start_time + 1) );
+}
+
+TEST(Process, NonexistentProcessIsNotAlive) {
+    EXPECT_FALSE( sc::Process::isAlive(0x7ffffff0u, 0) );
+    EXPECT_EQ( sc::Process::startTime(0x7ffffff0u), 0u );
+}
+
+TEST(Process, UnknownProcessIsAssumedAlive) {
+    EXPECT_TRUE( sc::Process::isAlive(0, 0) );
+}
+
 } //namespace MiscTest
@@ -0,0 +1,157 @@
+#include <softcamcore/Pacer.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <softcamcore/Misc.h>
+
+
+namespace PacerTest {
+namespace sc = softcam;
+
+const float FRAMERATE = 20.0f;
+const float PERIOD = 1.0f / FRAMERATE;
+const float TOLERANCE = 0.015f;
+
+// Returns how long the wait took.
+float timeWait(sc::Pacer& pacer)
+{
+    sc::Timer timer;
+    pacer.wait();
+    return timer.get();
+}
+
+
+TEST(Pacer, ZeroFramerateDoesntWait) {
+    sc::Pacer pacer;
+    float p50, p99;
+
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_LT( timeWait(pacer), TOLERANCE );
+    }
+    EXPECT_FALSE( pacer.jitter(&p50, &p99) );
+}
+
+TEST(Pacer, KeepsRegularPeriod) {
+    sc::Pacer pacer(FRAMERATE);
+
+    EXPECT_LT( timeWait(pacer), TOLERANCE ); // the first frame
+    sc::Timer timer;
+    for (int i = 0; i < 10; i++)
+    {
+        pacer.wait();
+        sc::Timer::sleep(PERIOD * 0.3f); // some work of the application
+    }
+    float elapsed = timer.get();
+    EXPECT_GT( elapsed, PERIOD * 10 - TOLERANCE );
+    EXPECT_LT( elapsed, PERIOD * 10.3f + TOLERANCE );
+
+    float p50 = -1.0f, p99 = -1.0f;
+    EXPECT_TRUE( pacer.jitter(&p50, &p99) );
+    EXPECT_GE( p50, 0.0f );
+    EXPECT_GE( p99, p50 );
+    EXPECT_LT( p50, 0.003f );
+}
+
+TEST(Pacer, ReportsHowItReleasedTheFrame) {
+    sc::Pacer pacer(FRAMERATE);
+
+    pacer.wait();
+    EXPECT_FALSE( pacer.slept() );
+    EXPECT_EQ( pacer.error(), 0 );
+
+    pacer.wait();
+    EXPECT_TRUE( pacer.slept() );
+    EXPECT_LT( pacer.error(), (int64_t)(TOLERANCE * 1e9f) );
+
+    sc::Timer::sleep(PERIOD * 1.2f);
+    pacer.wait();
+    EXPECT_FALSE( pacer.slept() );
+    EXPECT_GT( pacer.error(), (int64_t)(PERIOD * 0.2f * 1e9f) - 1000000 );
+}
+
+TEST(Pacer, ResetStartsOver) {
+    sc::Pacer pacer(FRAMERATE);
+
+    pacer.wait();
+    pacer.reset();
+    EXPECT_LT( timeWait(pacer), TOLERANCE );
+    EXPECT_GT( timeWait(pacer), PERIOD - TOLERANCE );
+}
+
+TEST(Pacer, BurstCatchesUp) {
+    sc::Pacer pacer(FRAMERATE, sc::Pacer::POLICY_BURST);
+
+    pacer.wait();
+    sc::Timer::sleep(PERIOD * 2.5f);
+    EXPECT_LT( timeWait(pacer), TOLERANCE ); // due 1.5 periods ago
+    EXPECT_LT( timeWait(pacer), TOLERANCE ); // due 0.5 periods ago
+    float t = timeWait(pacer);
+    EXPECT_GT( t, PERIOD * 0.5f - TOLERANCE );
+    EXPECT_LT( t, PERIOD * 0.5f + TOLERANCE );
+}
+
+TEST(Pacer, DropKeepsPhase) {
+    sc::Pacer pacer(FRAMERATE, sc::Pacer::POLICY_DROP);
+
+    pacer.wait();
+    sc::Timer::sleep(PERIOD * 2.5f);
+    EXPECT_LT( timeWait(pacer), TOLERANCE );
+    float t = timeWait(pacer);
+    EXPECT_GT( t, PERIOD * 0.5f - TOLERANCE );
+    EXPECT_LT( t, PERIOD * 0.5f + TOLERANCE );
+}
+
+TEST(Pacer, ReanchorStartsOverFromLateFrame) {
+    sc::Pacer pacer(FRAMERATE, sc::Pacer::POLICY_REANCHOR);
+
+    pacer.wait();
+    sc::Timer::sleep(PERIOD * 1.2f);
+    EXPECT_LT( timeWait(pacer), TOLERANCE );
+    float t = timeWait(pacer);
+    EXPECT_GT( t, PERIOD - TOLERANCE );
+    EXPECT_LT( t, PERIOD + TOLERANCE );
+}
+
+TEST(Pacer, DefaultCatchesUpOnlySmallDelays) {
+    {
+        sc::Pacer pacer(FRAMERATE);
+
+        pacer.wait();
+        sc::Timer::sleep(PERIOD * 1.2f);
+        EXPECT_LT( timeWait(pacer), TOLERANCE );
+        float t = timeWait(pacer);
+        EXPECT_GT( t, PERIOD * 0.8f - TOLERANCE );
+        EXPECT_LT( t, PERIOD * 0.8f + TOLERANCE );
+    }{
+        sc::Pacer pacer(FRAMERATE);
+
+        pacer.wait();
+        sc::Timer::sleep(PERIOD * 2.5f);
+        EXPECT_LT( timeWait(pacer), TOLERANCE );
+        float t = timeWait(pacer);
+        EXPECT_GT( t, PERIOD - TOLERANCE );
+        EXPECT_LT( t, PERIOD + TOLERANCE );
+    }
+}
+
+// Reports the jitter achieved at common framerates.
+// Run with --gtest_also_run_disabled_tests.
+TEST(Pacer, DISABLED_Jitter) {
+    const float FRAMERATES[] = { 30.0f, 60.0f, 120.0f, 240.0f };
+
+    std::printf("%10s %12s %12s\n", "framerate", "p50[us]", "p99[us]");
+    for (auto framerate : FRAMERATES)
+    {
+        sc::Pacer pacer(framerate);
+        for (int i = 0; i < (int)framerate * 3; i++)
+        {
+            pacer.wait();
+        }
+        float p50 = 0.0f, p99 = 0.0f;
+        pacer.jitter(&p50, &p99);
+        std::printf("%10.0f %12.1f %12.1f\n", framerate, p50 * 1e6f, p99 * 1e6f);
+    }
+}
+
+} //namespace PacerTest
@@ -1,10 +1,13 @@
 #include <softcamcore/SenderAPI.h>
 #include <gtest/gtest.h>
 
+#include <cstring>
+#include <vector>
 #include <atomic>
 #include <thread>
 #include <chrono>
 #include <cmath>
+#include <climits>
 #include <softcamcore/FrameBuffer.h>
 #include <softcamcore/Misc.h>
 
@@ -92,6 +95,137 @@ TEST(SenderCreateCamera, InvalidArgs) {
     }
 }
 
+TEST(SenderCreateCameraNamed, Basic)
+{
+    auto handle0 = sender::CreateCamera(320, 240, 60);
+    auto handle1 = sender::CreateCameraNamed("sendertest1", 640, 480, 30);
+    auto handle2 = sender::CreateCameraNamed("sendertest2", 1280, 720);
+    EXPECT_TRUE( handle0 );
+    EXPECT_TRUE( handle1 );
+    EXPECT_TRUE( handle2 );
+
+    auto fb0 = sc::FrameBuffer::open();
+    auto fb1 = sc::FrameBuffer::open("sendertest1");
+    auto fb2 = sc::FrameBuffer::open("sendertest2");
+    EXPECT_EQ( fb0.width(), 320 );
+    EXPECT_EQ( fb1.width(), 640 );
+    EXPECT_EQ( fb1.framerate(), 30 );
+    EXPECT_EQ( fb2.width(), 1280 );
+    EXPECT_EQ( fb2.framerate(), 60 );
+
+    std::vector<unsigned char> image(640 * 480 * 3);
+    sender::SendFrame(handle1, image.data());
+    EXPECT_EQ( fb0.frameCounter(), 0 );
+    EXPECT_EQ( fb1.frameCounter(), 1 );
+    EXPECT_EQ( fb2.frameCounter(), 0 );
+
+    sender::DeleteCamera(handle1);
+    EXPECT_FALSE( fb1.active() );
+    EXPECT_TRUE( fb2.active() );
+    sender::DeleteCamera(handle2);
+    sender::DeleteCamera(handle0);
+}
+
+TEST(SenderCreateCameraNamed, InvalidArgs)
+{
+    EXPECT_FALSE( sender::CreateCameraNamed("", 320, 240) );
+    EXPECT_FALSE( sender::CreateCameraNamed("sender/test", 320, 240) );
+    EXPECT_FALSE( sender::CreateCameraNamed("sendertest1", 0, 240) );
+
+    auto handle = sender::CreateCameraNamed("sendertest1", 320, 240);
+    EXPECT_TRUE( handle );
+    EXPECT_FALSE( sender::CreateCameraNamed("sendertest1", 320, 240) );
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderCreateCameraEx, BottomUp)
+{
+    auto handle = sender::CreateCameraEx(nullptr, 320, 240, 0, sender::CAMERA_FLAG_BOTTOM_UP);
+    EXPECT_TRUE( handle );
+
+    auto fb = sc::FrameBuffer::open();
+    EXPECT_TRUE( fb.bottomUp() );
+
+    void* image = nullptr;
+    int stride = 0;
+    EXPECT_TRUE( sender::AcquireFrameBuffer(handle, &image, &stride) );
+    EXPECT_EQ( stride, -320 * 3 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderCreateCameraEx, PacingPolicies)
+{
+    const unsigned FLAGS[] = {
+        sender::CAMERA_FLAG_PACING_DROP,
+        sender::CAMERA_FLAG_PACING_BURST,
+        sender::CAMERA_FLAG_PACING_REANCHOR,
+        sender::CAMERA_FLAG_PACING_DROP | sender::CAMERA_FLAG_BOTTOM_UP,
+    };
+    std::vector<unsigned char> image(320 * 240 * 3);
+    for (auto flags : FLAGS)
+    {
+        auto handle = sender::CreateCameraEx(nullptr, 320, 240, 100, flags);
+        EXPECT_TRUE( handle );
+
+        sc::Timer timer;
+        for (int i = 0; i < 3; i++)
+        {
+            sender::SendFrame(handle, image.data());
+        }
+        EXPECT_GE( timer.get(), 0.015f );
+
+        sender::DeleteCamera(handle);
+    }
+}
+
+TEST(SenderCreateCameraEx, SkipUnchanged)
+{
+    const float FRAMERATE = 100.0f;
+    auto handle = sender::CreateCameraEx(nullptr, 320, 240, FRAMERATE, sender::CAMERA_FLAG_SKIP_UNCHANGED);
+    EXPECT_TRUE( handle );
+    auto fb = sc::FrameBuffer::open();
+    std::vector<unsigned char> image(320 * 240 * 3, 10);
+
+    // Frames which are the same as the previous one still take their time.
+    sc::Timer timer;
+    for (int i = 0; i < 4; i++)
+    {
+        sender::SendFrame(handle, image.data());
+    }
+    EXPECT_GE( timer.get(), 3.0f / FRAMERATE - 0.005f );
+    EXPECT_EQ( fb.frameCounter(), 1 );
+
+    image[320 * 3 * 120] = 11;
+    sender::SendFrameWithTimestamp(handle, image.data(), 1);
+    EXPECT_EQ( fb.frameCounter(), 2 );
+    EXPECT_TRUE( sender::SendFrameEx(handle, image.data(), 320 * 3, 0) );
+    EXPECT_EQ( fb.frameCounter(), 2 );
+
+    // The other ways of sending a frame always send it.
+    void* bits = nullptr;
+    int stride = 0;
+    sender::AcquireFrameBuffer(handle, &bits, &stride);
+    sender::CommitFrame(handle);
+    EXPECT_EQ( fb.frameCounter(), 3 );
+    sender::SendFrame(handle, image.data());
+    EXPECT_EQ( fb.frameCounter(), 4 );
+
+    sender::CameraStats stats;
+    EXPECT_TRUE( sender::GetCameraStats(handle, &stats) );
+    EXPECT_EQ( stats.frames_written, 4 );
+    EXPECT_EQ( stats.unchanged_frames, 4 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderCreateCameraEx, InvalidArgs)
+{
+    EXPECT_FALSE( sender::CreateCameraEx(nullptr, 320, 240, 60, 0x8000) );
+    EXPECT_FALSE( sender::CreateCameraEx("", 320, 240, 60, 0) );
+    EXPECT_FALSE( sender::CreateCameraEx(nullptr, 0, 240, 60, sender::CAMERA_FLAG_BOTTOM_UP) );
+}
+
 TEST(SenderDeleteCamera, InvalidArgs)
 {
     auto handle = sender::CreateCamera(320, 240);
@@ -281,6 +415,337 @@ TEST(SenderSendFrame, InvalidArgs)
     EXPECT_EQ( fb.frameCounter(), 1 );
 }
 
+TEST(SenderSendFrameWithTimestamp, Basic)
+{
+    const float FRAMERATE = 20.0f;
+    const float INTERVAL = 1.0f / FRAMERATE;
+    auto handle = sender::CreateCamera(320, 240, FRAMERATE);
+    auto fb = sc::FrameBuffer::open();
+    unsigned char image[320 * 240 * 3] = {};
+    uint64_t frame_counter = 0, timestamp = 0;
+
+    sender::SendFrameWithTimestamp(handle, image, 1000);
+    fb.transferToDIB(image, &frame_counter, &timestamp);
+    EXPECT_EQ( frame_counter, 1 );
+    EXPECT_EQ( timestamp, 1000 );
+
+    // Paced in the same way as SendFrame.
+    sc::Timer timer;
+    sender::SendFrameWithTimestamp(handle, image, 2000);
+    EXPECT_GE( timer.get(), INTERVAL - 0.010f );
+    fb.transferToDIB(image, &frame_counter, &timestamp);
+    EXPECT_EQ( frame_counter, 2 );
+    EXPECT_EQ( timestamp, 2000 );
+
+    EXPECT_NO_THROW({ sender::SendFrameWithTimestamp(nullptr, image, 0); });
+    EXPECT_NO_THROW({ sender::SendFrameWithTimestamp(handle, nullptr, 0); });
+    EXPECT_EQ( fb.frameCounter(), 2 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSendFrameEx, Basic)
+{
+    const int W = 320, H = 240, ROW = W * 3;
+    auto handle = sender::CreateCamera(W, H, 0.0f);
+    auto fb = sc::FrameBuffer::open();
+
+    // A part of a larger canvas
+    const int CANVAS_W = 400, CANVAS_STRIDE = CANVAS_W * 3;
+    std::vector<unsigned char> canvas((std::size_t)CANVAS_STRIDE * (H + 10), 0);
+    for (int y = 0; y < H; y++)
+    {
+        std::memset(&canvas[(std::size_t)CANVAS_STRIDE * (y + 10) + 3 * 20], y, ROW);
+    }
+    const unsigned char* crop = &canvas[(std::size_t)CANVAS_STRIDE * 10 + 3 * 20];
+    EXPECT_TRUE( sender::SendFrameEx(handle, crop, CANVAS_STRIDE, 0) );
+
+    std::vector<unsigned char> dib((std::size_t)ROW * H);
+    uint64_t frame_counter = 0;
+    fb.transferToDIB(dib.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 1 );
+    EXPECT_EQ( dib[(std::size_t)ROW * (H - 1)], 0 );    // the top row
+    EXPECT_EQ( dib[0], H - 1 );                         // the bottom row
+
+    // A bottom-up image is given by its lowest address.
+    EXPECT_TRUE( sender::SendFrameEx(handle, dib.data(), -ROW, 0) );
+    std::vector<unsigned char> dib2((std::size_t)ROW * H);
+    fb.transferToDIB(dib2.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 2 );
+    EXPECT_EQ( dib2, dib );
+
+    EXPECT_FALSE( sender::SendFrameEx(nullptr, dib.data(), ROW, 0) );
+    EXPECT_FALSE( sender::SendFrameEx(handle, nullptr, ROW, 0) );
+    EXPECT_FALSE( sender::SendFrameEx(handle, dib.data(), ROW - 1, 0) );
+    EXPECT_FALSE( sender::SendFrameEx(handle, dib.data(), -ROW + 1, 0) );
+    EXPECT_FALSE( sender::SendFrameEx(handle, dib.data(), 0, 0) );
+    EXPECT_FALSE( sender::SendFrameEx(handle, dib.data(), INT_MIN, 0) );
+    EXPECT_FALSE( sender::SendFrameEx(handle, dib.data(), ROW, 1) );
+    EXPECT_EQ( fb.frameCounter(), 2 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSendFrameRegions, Basic)
+{
+    const int W = 320, H = 240, ROW = W * 3;
+    auto handle = sender::CreateCamera(W, H, 0.0f);
+    auto fb = sc::FrameBuffer::open();
+
+    std::vector<unsigned char> image((std::size_t)ROW * H, 10);
+    sender::SendFrame(handle, image.data());
+    std::fill(image.begin(), image.end(), 20);
+    sender::Rect rects[] = { { 0, 0, 4, 4 }, { 316, 236, 4, 4 } };
+    EXPECT_TRUE( sender::SendFrameRegions(handle, image.data(), rects, 2) );
+
+    std::vector<unsigned char> dib((std::size_t)ROW * H);
+    uint64_t frame_counter = 0;
+    fb.transferToDIB(dib.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 2 );
+    EXPECT_EQ( dib[(std::size_t)ROW * (H - 1)], 20 );   // the top-left corner
+    EXPECT_EQ( dib[ROW - 1], 20 );                      // the bottom-right corner
+    EXPECT_EQ( dib[(std::size_t)ROW * (H / 2)], 10 );
+
+    // No changes but a new frame
+    EXPECT_TRUE( sender::SendFrameRegions(handle, image.data(), nullptr, 0) );
+    EXPECT_EQ( fb.frameCounter(), 3 );
+
+    EXPECT_FALSE( sender::SendFrameRegions(nullptr, image.data(), rects, 2) );
+    EXPECT_FALSE( sender::SendFrameRegions(handle, nullptr, rects, 2) );
+    EXPECT_FALSE( sender::SendFrameRegions(handle, image.data(), nullptr, 2) );
+    EXPECT_FALSE( sender::SendFrameRegions(handle, image.data(), rects, -1) );
+    EXPECT_EQ( fb.frameCounter(), 3 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSendFrameAsync, Basic)
+{
+    const float TIMEOUT = 1.0f;
+    const unsigned char COLOR_VALUE = 123;
+
+    auto handle = sender::CreateCamera(320, 240);
+    auto fb = sc::FrameBuffer::open();
+    EXPECT_EQ( sender::GetFrameQueueDepth(handle), 0 );
+
+    unsigned char image[320 * 240 * 3] = {};
+    std::memset(image, COLOR_VALUE, sizeof(image));
+    sender::SendFrameAsync(handle, image);
+    std::memset(image, 0, sizeof(image));
+
+    EXPECT_TRUE( fb.waitForNewFrame(0, TIMEOUT) );
+    EXPECT_EQ( fb.frameCounter(), 1 );
+
+    unsigned char received[320 * 240 * 3];
+    uint64_t frame_counter = 0, timestamp = 0;
+    fb.transferToDIB(received, &frame_counter, &timestamp);
+    EXPECT_LE( timestamp, sc::Timer::now() );
+    EXPECT_GT( timestamp, sc::Timer::now() - 1000000000 );
+    EXPECT_EQ( received[0], COLOR_VALUE );
+    EXPECT_EQ( received[320 * 240 * 3 - 1], COLOR_VALUE );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSendFrameAsync, ReturnsWithoutWaitingForFrameTime)
+{
+    const float FRAMERATE = 20.0f;
+    const float INTERVAL = 1.0f / FRAMERATE;
+    auto handle = sender::CreateCameraEx(nullptr, 320, 240, FRAMERATE, sender::CAMERA_FLAG_ASYNC_BLOCK);
+    auto fb = sc::FrameBuffer::open();
+    unsigned char image[320 * 240 * 3] = {};
+
+    sc::Timer timer;
+    for (int i = 0; i < 3; i++)
+    {
+        sender::SendFrameAsync(handle, image);
+    }
+    EXPECT_LE( timer.get(), 0.010f );
+    EXPECT_GE( sender::GetFrameQueueDepth(handle), 1 );
+
+    // The synchronous call comes after the queued frames.
+    sender::SendFrame(handle, image);
+    EXPECT_EQ( fb.frameCounter(), 4 );
+    EXPECT_EQ( sender::GetFrameQueueDepth(handle), 0 );
+    EXPECT_GE( timer.get(), INTERVAL * 3.0f - 0.010f );
+    EXPECT_LE( timer.get(), INTERVAL * 3.0f + 0.030f );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSendFrameAsync, DropsOldestFramesByDefault)
+{
+    const float FRAMERATE = 20.0f;
+    auto handle = sender::CreateCamera(320, 240, FRAMERATE);
+    auto fb = sc::FrameBuffer::open();
+    unsigned char image[320 * 240 * 3] = {};
+
+    sc::Timer timer;
+    for (int i = 0; i < 10; i++)
+    {
+        sender::SendFrameAsync(handle, image);
+    }
+    EXPECT_LE( timer.get(), 0.020f );
+    EXPECT_LE( sender::GetFrameQueueDepth(handle), sender::FRAME_QUEUE_CAPACITY + 1 );
+
+    void* bits = nullptr;
+    int stride = 0;
+    EXPECT_TRUE( sender::AcquireFrameBuffer(handle, &bits, &stride) ); // flushes the queue
+    EXPECT_EQ( sender::GetFrameQueueDepth(handle), 0 );
+    EXPECT_LT( fb.frameCounter(), 10 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSendFrameAsync, InvalidArgs)
+{
+    auto handle = sender::CreateCamera(320, 240);
+    unsigned char image[320 * 240 * 3] = {};
+
+    EXPECT_NO_THROW({ sender::SendFrameAsync(nullptr, nullptr); });
+    EXPECT_NO_THROW({ sender::SendFrameAsync(nullptr, image); });
+    EXPECT_NO_THROW({ sender::SendFrameAsync(handle, nullptr); });
+    EXPECT_EQ( sender::GetFrameQueueDepth(nullptr), 0 );
+
+    sender::SendFrameAsync(handle, image);
+    sender::DeleteCamera(handle); // discards the queue
+
+    EXPECT_NO_THROW({ sender::SendFrameAsync(handle, image); });
+    EXPECT_EQ( sender::GetFrameQueueDepth(handle), 0 );
+}
+
+TEST(SenderAcquireFrameBuffer, Basic)
+{
+    const unsigned char COLOR_VALUE = 123;
+    auto handle = sender::CreateCamera(320, 240);
+    auto fb = sc::FrameBuffer::open();
+    ASSERT_TRUE( fb );
+
+    void* bits = nullptr;
+    int stride = 0;
+    bool ret = sender::AcquireFrameBuffer(handle, &bits, &stride);
+    ASSERT_EQ( ret, true );
+    ASSERT_NE( bits, nullptr );
+    ASSERT_GE( stride, 320 * 3 );
+    for (int y = 0; y < 240; y++)
+    {
+        std::memset((unsigned char*)bits + stride * y, COLOR_VALUE, 320 * 3);
+    }
+    EXPECT_EQ( fb.frameCounter(), 0 );
+
+    sender::CommitFrame(handle);
+    EXPECT_EQ( fb.frameCounter(), 1 );
+
+    unsigned char image[320 * 240 * 3] = {};
+    uint64_t frame_counter = 0;
+    fb.transferToDIB(image, &frame_counter);
+    EXPECT_EQ( frame_counter, 1 );
+    EXPECT_EQ( image[0], COLOR_VALUE );
+    EXPECT_EQ( image[320 * 240 * 3 - 1], COLOR_VALUE );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderAcquireFrameBuffer, CommitWithoutAcquireDoesNothing)
+{
+    auto handle = sender::CreateCamera(320, 240);
+    auto fb = sc::FrameBuffer::open();
+
+    sender::CommitFrame(handle);
+    EXPECT_EQ( fb.frameCounter(), 0 );
+
+    void* bits = nullptr;
+    int stride = 0;
+    sender::AcquireFrameBuffer(handle, &bits, &stride);
+    sender::CommitFrame(handle);
+    sender::CommitFrame(handle);
+    EXPECT_EQ( fb.frameCounter(), 1 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderAcquireFrameBuffer, KeepsProperInterval)
+{
+    const float FRAMERATE = 20.0f;
+    const float INTERVAL = 1.0f / FRAMERATE;
+    auto handle = sender::CreateCamera(320, 240, FRAMERATE);
+    void* bits = nullptr;
+    int stride = 0;
+
+    sender::AcquireFrameBuffer(handle, &bits, &stride);
+    sender::CommitFrame(handle);   // first
+
+    sc::Timer timer;
+    sender::AcquireFrameBuffer(handle, &bits, &stride);
+    sender::CommitFrame(handle);   // second
+    auto lap1 = timer.get();
+
+    EXPECT_GE( lap1, INTERVAL * 1.0f - 0.010f );
+    EXPECT_LE( lap1, INTERVAL * 1.0f + 0.010f );
+
+    sender::AcquireFrameBuffer(handle, &bits, &stride);
+    sender::CommitFrame(handle);   // third
+    auto lap2 = timer.get();
+
+    EXPECT_GE( lap2, INTERVAL * 2.0f - 0.010f );
+    EXPECT_LE( lap2, INTERVAL * 2.0f + 0.010f );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderAcquireFrameBuffer, InvalidArgs)
+{
+    void* bits = nullptr;
+    int stride = 0;
+    EXPECT_EQ( sender::AcquireFrameBuffer(nullptr, &bits, &stride), false );
+    EXPECT_NO_THROW({ sender::CommitFrame(nullptr); });
+
+    auto handle = sender::CreateCamera(320, 240);
+    EXPECT_EQ( sender::AcquireFrameBuffer(handle, nullptr, &stride), false );
+    EXPECT_EQ( sender::AcquireFrameBuffer(handle, &bits, nullptr), false );
+    sender::DeleteCamera(handle);
+
+    EXPECT_EQ( sender::AcquireFrameBuffer(handle, &bits, &stride), false );
+    EXPECT_NO_THROW({ sender::CommitFrame(handle); });
+}
+
+TEST(SenderGetCameraStats, Basic)
+{
+    const float FRAMERATE = 100.0f;
+    auto handle = sender::CreateCamera(320, 240, FRAMERATE);
+    auto fb = sc::FrameBuffer::open();
+    unsigned char image[320 * 240 * 3] = {};
+    uint64_t frame_counter = 0;
+
+    sender::CameraStats stats;
+    EXPECT_TRUE( sender::GetCameraStats(handle, &stats) );
+    EXPECT_EQ( stats.frames_written, 0 );
+    EXPECT_EQ( stats.receivers, 1 );
+
+    for (int i = 0; i < 3; i++)
+    {
+        sender::SendFrame(handle, image);
+        fb.transferToDIB(image, &frame_counter);
+    }
+    sender::SendFrame(handle, image);
+    sender::SendFrame(handle, image);
+    fb.transferToDIB(image, &frame_counter);
+
+    EXPECT_TRUE( sender::GetCameraStats(handle, &stats) );
+    EXPECT_EQ( stats.frames_written, 5 );
+    EXPECT_EQ( stats.frames_read, 4 );
+    EXPECT_EQ( stats.frames_skipped, 1 );
+    EXPECT_EQ( stats.paced_frames + stats.late_frames, 4 );
+    EXPECT_EQ( stats.mutex_waits, 5 );
+    EXPECT_GT( stats.jitter_p99_ns, 0 );
+    EXPECT_GE( stats.jitter_p99_ns, stats.jitter_p50_ns );
+
+    EXPECT_FALSE( sender::GetCameraStats(handle, nullptr) );
+    EXPECT_FALSE( sender::GetCameraStats(nullptr, &stats) );
+    sender::DeleteCamera(handle);
+    EXPECT_FALSE( sender::GetCameraStats(handle, &stats) );
+}
+
 TEST(SenderWaitForConnection, ShouldBlockUntilReceiverConnected)
 {
     auto handle = sender::CreateCamera(320, 240);
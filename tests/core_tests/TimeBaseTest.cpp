@@ -0,0 +1,99 @@
+#include <softcamcore/TimeBase.h>
+#include <gtest/gtest.h>
+
+
+namespace TimeBaseTest {
+namespace sc = softcam;
+
+const uint64_t MS = 1000000;
+
+
+TEST(TimeBase, FirstFrameIsMappedToArrivalTime) {
+    sc::TimeBase tb(1000 * MS);
+
+    EXPECT_EQ( tb.map(123456789, 1020 * MS), 20 * MS );
+}
+
+TEST(TimeBase, KeepsIntervalsOfTimestamps) {
+    sc::TimeBase tb(1000 * MS);
+
+    EXPECT_EQ( tb.map(50 * MS, 1000 * MS), 0 );
+    // Arrivals are jittery while the timestamps are not.
+    EXPECT_EQ( tb.map(60 * MS, 1013 * MS), 10 * MS );
+    EXPECT_EQ( tb.map(70 * MS, 1018 * MS), 20 * MS );
+    // Variable intervals are kept as they are.
+    EXPECT_EQ( tb.map(75 * MS, 1026 * MS), 25 * MS );
+    EXPECT_EQ( tb.map(200 * MS, 1150 * MS), 150 * MS );
+}
+
+TEST(TimeBase, StartsOverIfTimestampsGoBack) {
+    sc::TimeBase tb(0);
+
+    EXPECT_EQ( tb.map(500 * MS, 100 * MS), 100 * MS );
+    EXPECT_EQ( tb.map(510 * MS, 110 * MS), 110 * MS );
+    // Another sender with another clock.
+    EXPECT_EQ( tb.map(20 * MS, 130 * MS), 130 * MS );
+    EXPECT_EQ( tb.map(30 * MS, 140 * MS), 140 * MS );
+}
+
+TEST(TimeBase, StartsOverIfTimestampsStray) {
+    sc::TimeBase tb(0);
+
+    EXPECT_EQ( tb.map(0, 100 * MS), 100 * MS );
+    // The sender has paused for a while without advancing its clock.
+    EXPECT_EQ( tb.map(10 * MS, 2000 * MS), 2000 * MS );
+    EXPECT_EQ( tb.map(20 * MS, 2010 * MS), 2010 * MS );
+    // The sender's clock has jumped ahead.
+    EXPECT_EQ( tb.map(5000 * MS, 2020 * MS), 2020 * MS );
+}
+
+TEST(TimeBase, NeverGoesBackwards) {
+    sc::TimeBase tb(0);
+    const uint64_t STEP = sc::TimeBase::MIN_STEP;
+
+    EXPECT_EQ( tb.map(100 * MS, 100 * MS), 100 * MS );
+    EXPECT_EQ( tb.map(300 * MS, 110 * MS), 300 * MS );          // ahead of the local clock
+    EXPECT_EQ( tb.map(0, 120 * MS), 300 * MS + STEP );          // starts over
+    EXPECT_EQ( tb.map(10 * MS, 130 * MS), 310 * MS + STEP );
+}
+
+TEST(TimeBase, RepeatedTimestampIsMappedToLaterTime) {
+    sc::TimeBase tb(0);
+    const uint64_t STEP = sc::TimeBase::MIN_STEP;
+
+    EXPECT_EQ( tb.map(10 * MS, 100 * MS), 100 * MS );
+    EXPECT_EQ( tb.map(10 * MS, 110 * MS), 100 * MS + STEP );
+    EXPECT_EQ( tb.map(10 * MS, 120 * MS), 100 * MS + 2 * STEP );
+    EXPECT_EQ( tb.map(20 * MS, 125 * MS), 110 * MS );
+}
+
+TEST(TimeBase, RepeatedFrameFollowsLocalClock) {
+    sc::TimeBase tb(0);
+    const uint64_t STEP = sc::TimeBase::MIN_STEP;
+
+    EXPECT_EQ( tb.map(0, 100 * MS), 100 * MS );
+    // No new frame has arrived for a while.
+    EXPECT_EQ( tb.repeat(600 * MS), 600 * MS );
+    EXPECT_EQ( tb.repeat(600 * MS), 600 * MS + STEP );
+    EXPECT_EQ( tb.repeat(1100 * MS), 1100 * MS );
+    // The next frame starts after the repeated ones, and the frames after
+    // it keep their intervals.
+    EXPECT_EQ( tb.map(1000 * MS, 1105 * MS), 1100 * MS + STEP );
+    EXPECT_EQ( tb.map(1010 * MS, 1115 * MS), 1110 * MS );
+    // A repeat doesn't go before the last frame.
+    EXPECT_EQ( tb.repeat(1112 * MS), 1112 * MS );
+    EXPECT_EQ( tb.map(1020 * MS, 1113 * MS), 1120 * MS );
+    EXPECT_EQ( tb.repeat(1114 * MS), 1120 * MS + STEP );
+}
+
+TEST(TimeBase, ResetAndRestart) {
+    sc::TimeBase tb(0);
+
+    EXPECT_EQ( tb.map(0, 100 * MS), 100 * MS );
+    tb.restart();
+    EXPECT_EQ( tb.map(10 * MS, 200 * MS), 200 * MS );
+    tb.reset(1000 * MS);
+    EXPECT_EQ( tb.map(20 * MS, 1005 * MS), 5 * MS );
+}
+
+} //namespace TimeBaseTest
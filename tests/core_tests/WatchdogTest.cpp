@@ -4,6 +4,7 @@
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <vector>
 
 
 namespace WatchdogTest {
@@ -167,4 +168,69 @@ TEST(Watchdog, MonitorDetectsRevival)
     EXPECT_EQ( monitor.alive(), true );
 }
 
+TEST(Watchdog, ManyWatchdogsRunConcurrently)
+{
+    const int NUM_WATCHDOGS = 100;
+    const float HEARTBEAT_INTERVAL = 0.01f;
+    const float MONITOR_INTERVAL = 0.01f;
+    const float MONITOR_TIMEOUT = 0.20f;
+
+    std::vector<std::atomic<unsigned>> signals(NUM_WATCHDOGS);
+    std::vector<sc::Watchdog> heartbeats, monitors;
+    for (int i = 0; i < NUM_WATCHDOGS; i++)
+    {
+        auto signal = &signals[i];
+        heartbeats.push_back(sc::Watchdog::createHeartbeat(
+                        HEARTBEAT_INTERVAL * (1 + i % 3),
+                        [signal] { ++*signal; }));
+        monitors.push_back(sc::Watchdog::createMonitor(
+                        MONITOR_INTERVAL,
+                        MONITOR_TIMEOUT,
+                        [signal] { return signal->load(); }));
+    }
+
+    SLEEP_S(MONITOR_TIMEOUT * 2);
+    for (int i = 0; i < NUM_WATCHDOGS; i++)
+    {
+        EXPECT_NE( signals[i].load(), 0u );
+        EXPECT_EQ( monitors[i].alive(), true );
+    }
+
+    for (int i = 0; i < NUM_WATCHDOGS; i += 2)
+    {
+        heartbeats[i].stop();
+    }
+    SLEEP_S(MONITOR_TIMEOUT + MONITOR_INTERVAL * 5);
+    for (int i = 0; i < NUM_WATCHDOGS; i++)
+    {
+        EXPECT_EQ( monitors[i].alive(), i % 2 == 1 );
+    }
+}
+
+TEST(Watchdog, StopWaitsForRunningCallback)
+{
+    std::atomic<bool>       running = false;
+    std::atomic<unsigned>   signal = 0;
+
+    auto heartbeat = sc::Watchdog::createHeartbeat(
+                        0.001f,
+                        [&] {
+                            running = true;
+                            SLEEP_S(0.05f);
+                            ++signal;
+                            running = false;
+                        });
+
+    while (!running.load())
+    {
+        SLEEP_S(0.001f);
+    }
+    heartbeat.stop();
+    EXPECT_EQ( running.load(), false );
+
+    auto value = signal.load();
+    SLEEP_S(0.1f);
+    EXPECT_EQ( signal.load(), value );
+}
+
 } //namespace WatchdogTest
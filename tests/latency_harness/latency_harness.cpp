@@ -0,0 +1,399 @@
+#include <softcamcore/SenderAPI.h>
+#include <softcamcore/FrameBuffer.h>
+#include <softcamcore/Misc.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#if defined(_WIN32)
+#include <windows.h>
+#define popen _popen
+#define pclose _pclose
+#else
+#include <sys/resource.h>
+#endif
+
+
+// latency_harness - the end-to-end latency of Softcam across processes
+//
+// This runs itself as a sender process and as N receiver processes.
+// The sender calls SendFrame() at the given framerate and embeds the time
+// of each call in the first pixels of the frame. The receivers wait for
+// frames with waitForNewFrame() and copy them with transferToDIB() as the
+// DirectShow filter does, and take the time when they have the pixels.
+// The harness reports the distribution of the latency over all receivers
+// and the CPU time of each side, as text or as JSON to be recorded by
+// automated runs.
+//
+//   usage: latency_harness [-r RECEIVERS] [-n FRAMES] [-f FPS]
+//                          [-s WIDTHxHEIGHT] [--json]
+
+
+namespace sc = softcam;
+namespace sender = softcam::sender;
+
+const char CAMERA_NAME[] = "Softcam Latency Harness";
+const float STARTUP_TIMEOUT = 10.0f;
+
+
+struct Options
+{
+    int     receivers = 1;
+    int     frames = 600;
+    int     framerate = 60;
+    int     width = 1920;
+    int     height = 1080;
+    bool    json = false;
+};
+
+
+// The CPU time consumed by all threads of this process in nanoseconds.
+static uint64_t processCpuTime()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    auto to_ns = [](const FILETIME& t)
+    {
+        return (((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) * 100;
+    };
+    return to_ns(kernel) + to_ns(user);
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    auto to_ns = [](const struct timeval& t)
+    {
+        return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_usec * 1000;
+    };
+    return to_ns(usage.ru_utime) + to_ns(usage.ru_stime);
+#endif
+}
+
+
+// The sender process. Prints "sender <frames> <cpu_ns>".
+static int runSender(const Options& options)
+{
+    // Frames are paced here rather than by the camera, so that the time
+    // SendFrame() takes doesn't include the wait for the schedule.
+    auto camera = sender::CreateCameraNamed(
+                        CAMERA_NAME, options.width, options.height, 0.0f);
+    if (!camera)
+    {
+        std::fprintf(stderr, "failed to create the camera\n");
+        return 1;
+    }
+    sc::Timer timer;
+    sender::CameraStats stats = {};
+    while (sender::GetCameraStats(camera, &stats) &&
+            (int)stats.receivers < options.receivers)
+    {
+        if (STARTUP_TIMEOUT < timer.get())
+        {
+            std::fprintf(stderr, "receivers didn't connect\n");
+            sender::DeleteCamera(camera);
+            return 1;
+        }
+        sc::Timer::sleep(0.01f);
+    }
+
+    std::vector<uint8_t> image((std::size_t)3 * options.width * options.height, 0);
+    const uint64_t interval = 1000000000 / (uint64_t)options.framerate;
+    const uint64_t cpu_start = processCpuTime();
+    uint64_t deadline = sc::Timer::now();
+    for (int i = 0; i < options.frames; i++)
+    {
+        // A coarse sleep is enough as the latency is measured from the call,
+        // and it doesn't add the CPU time of spinning to the sender's.
+        deadline += interval;
+        uint64_t now = sc::Timer::now();
+        if (now < deadline)
+        {
+            sc::Timer::sleep((float)((double)(deadline - now) * 1e-9));
+        }
+        now = sc::Timer::now();
+        std::memcpy(image.data(), &now, sizeof(now));
+        sender::SendFrame(camera, image.data());
+    }
+    const uint64_t cpu_time = processCpuTime() - cpu_start;
+
+    // Give the receivers time to take the last frame.
+    sc::Timer::sleep(0.1f);
+    sender::DeleteCamera(camera);
+    std::printf("sender %d %llu\n", options.frames, (unsigned long long)cpu_time);
+    return 0;
+}
+
+
+// A receiver process. Prints "receiver <frames> <skipped> <cpu_ns>" and
+// then the latency of each frame in nanoseconds, one per line.
+static int runReceiver(const Options& options)
+{
+    sc::Timer timer;
+    auto fb = sc::FrameBuffer::open(CAMERA_NAME);
+    while (!fb)
+    {
+        if (STARTUP_TIMEOUT < timer.get())
+        {
+            std::fprintf(stderr, "failed to open the camera\n");
+            return 1;
+        }
+        sc::Timer::sleep(0.01f);
+        fb = sc::FrameBuffer::open(CAMERA_NAME);
+    }
+    const int width = fb.width();
+    const int height = fb.height();
+    std::vector<uint8_t> dib((std::size_t)3 * width * height);
+    std::vector<uint64_t> latencies;
+    latencies.reserve(options.frames);
+
+    const uint64_t cpu_start = processCpuTime();
+    uint64_t skipped = 0;
+    uint64_t frame_counter = 0;
+    for (;;)
+    {
+        if (!fb.waitForNewFrame(frame_counter, 1.0f))
+        {
+            break;
+        }
+        uint64_t last = frame_counter;
+        fb.transferToDIB(dib.data(), &frame_counter);
+        uint64_t now = sc::Timer::now();
+        if (frame_counter == last)
+        {
+            // Timed out without a new frame.
+            continue;
+        }
+        if (last != 0 && last + 1 < frame_counter)
+        {
+            skipped += frame_counter - last - 1;
+        }
+        // The top row of the image is the bottom row of the DIB.
+        uint64_t sent;
+        std::memcpy(&sent, dib.data() + (std::size_t)3 * width * (height - 1), sizeof(sent));
+        latencies.push_back(now - sent);
+    }
+    const uint64_t cpu_time = processCpuTime() - cpu_start;
+    std::printf("receiver %zu %llu %llu\n", latencies.size(),
+                (unsigned long long)skipped, (unsigned long long)cpu_time);
+    for (auto latency : latencies)
+    {
+        std::printf("%llu\n", (unsigned long long)latency);
+    }
+    return 0;
+}
+
+
+struct Result
+{
+    bool                    ok = false;
+    uint64_t                frames = 0;
+    uint64_t                skipped = 0;
+    uint64_t                cpu_time = 0;
+    std::vector<uint64_t>   latencies;
+};
+
+static Result readResult(FILE* pipe, const char* role)
+{
+    Result result;
+    char label[16] = {};
+    unsigned long long frames = 0, skipped = 0, cpu_time = 0;
+    if (std::strcmp(role, "sender") == 0)
+    {
+        result.ok = std::fscanf(pipe, "%15s %llu %llu", label, &frames, &cpu_time) == 3;
+    }
+    else
+    {
+        result.ok = std::fscanf(pipe, "%15s %llu %llu %llu", label, &frames, &skipped, &cpu_time) == 4;
+    }
+    result.ok = result.ok && std::strcmp(label, role) == 0;
+    result.frames = frames;
+    result.skipped = skipped;
+    result.cpu_time = cpu_time;
+    unsigned long long latency;
+    while (result.ok && result.latencies.size() < frames &&
+            std::fscanf(pipe, "%llu", &latency) == 1)
+    {
+        result.latencies.push_back(latency);
+    }
+    return result;
+}
+
+static double percentile(const std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    std::size_t index = std::min(sorted.size() - 1, (std::size_t)(p * (double)sorted.size()));
+    return (double)sorted[index] * 1e-3;
+}
+
+// The coordinator, which runs the sender and the receivers and reports.
+static int runHarness(const char* self, const Options& options)
+{
+    char args[128];
+    std::snprintf(args, sizeof(args), " -r %d -n %d -f %d -s %dx%d",
+                  options.receivers, options.frames, options.framerate,
+                  options.width, options.height);
+    const std::string command = std::string("\"") + self + "\"" + args;
+
+    // The receivers wait for the camera, and the sender waits for
+    // the receivers to connect.
+    std::vector<FILE*> receivers;
+    for (int i = 0; i < options.receivers; i++)
+    {
+        receivers.push_back(popen((command + " --receiver").c_str(), "r"));
+    }
+    FILE* sender_pipe = popen((command + " --sender").c_str(), "r");
+
+    bool ok = sender_pipe != nullptr;
+    Result sender_result;
+    if (sender_pipe)
+    {
+        sender_result = readResult(sender_pipe, "sender");
+        ok = pclose(sender_pipe) == 0 && sender_result.ok && ok;
+    }
+    std::vector<uint64_t> latencies;
+    uint64_t frames = 0, skipped = 0, cpu_time = 0;
+    for (FILE* pipe : receivers)
+    {
+        if (!pipe)
+        {
+            ok = false;
+            continue;
+        }
+        Result result = readResult(pipe, "receiver");
+        ok = pclose(pipe) == 0 && result.ok && ok;
+        frames += result.frames;
+        skipped += result.skipped;
+        cpu_time += result.cpu_time;
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+    }
+    if (!ok)
+    {
+        std::fprintf(stderr, "latency_harness: the run failed\n");
+        return 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0.0;
+    for (auto latency : latencies)
+    {
+        sum += (double)latency * 1e-3;
+    }
+    const double mean = latencies.empty() ? 0.0 : sum / (double)latencies.size();
+    const double sender_cpu = (double)sender_result.cpu_time * 1e-3 /
+                              (double)std::max<uint64_t>(sender_result.frames, 1);
+    const double receiver_cpu = (double)cpu_time * 1e-3 / (double)std::max<uint64_t>(frames, 1);
+
+    if (options.json)
+    {
+        std::printf("{\n");
+        std::printf("  \"width\": %d,\n  \"height\": %d,\n", options.width, options.height);
+        std::printf("  \"framerate\": %d,\n  \"receivers\": %d,\n", options.framerate, options.receivers);
+        std::printf("  \"frames_sent\": %llu,\n", (unsigned long long)sender_result.frames);
+        std::printf("  \"frames_received\": %llu,\n", (unsigned long long)frames);
+        std::printf("  \"frames_skipped\": %llu,\n", (unsigned long long)skipped);
+        std::printf("  \"latency_us\": { \"mean\": %.3f, \"min\": %.3f, \"p50\": %.3f, "
+                    "\"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f },\n",
+                    mean, percentile(latencies, 0.0), percentile(latencies, 0.5),
+                    percentile(latencies, 0.9), percentile(latencies, 0.99),
+                    percentile(latencies, 0.999), percentile(latencies, 1.0));
+        std::printf("  \"sender_cpu_us_per_frame\": %.3f,\n", sender_cpu);
+        std::printf("  \"receiver_cpu_us_per_frame\": %.3f\n", receiver_cpu);
+        std::printf("}\n");
+    }
+    else
+    {
+        std::printf("%dx%d at %d fps, %d receiver(s)\n",
+                    options.width, options.height, options.framerate, options.receivers);
+        std::printf("frames: sent %llu, received %llu, skipped %llu\n",
+                    (unsigned long long)sender_result.frames,
+                    (unsigned long long)frames, (unsigned long long)skipped);
+        std::printf("latency (us): mean %.1f  min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+                    mean, percentile(latencies, 0.0), percentile(latencies, 0.5),
+                    percentile(latencies, 0.9), percentile(latencies, 0.99),
+                    percentile(latencies, 0.999), percentile(latencies, 1.0));
+        std::printf("cpu (us/frame): sender %.1f  receiver %.1f\n", sender_cpu, receiver_cpu);
+    }
+    return 0;
+}
+
+
+static bool parseOptions(int argc, char* argv[], Options* options, const char** role)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(arg, "--json") == 0)
+        {
+            options->json = true;
+            continue;
+        }
+        if (std::strcmp(arg, "--sender") == 0 || std::strcmp(arg, "--receiver") == 0)
+        {
+            *role = arg + 2;
+            continue;
+        }
+        if (!value)
+        {
+            return false;
+        }
+        if (std::strcmp(arg, "-r") == 0)
+        {
+            options->receivers = std::atoi(value);
+        }
+        else if (std::strcmp(arg, "-n") == 0)
+        {
+            options->frames = std::atoi(value);
+        }
+        else if (std::strcmp(arg, "-f") == 0)
+        {
+            options->framerate = std::atoi(value);
+        }
+        else if (std::strcmp(arg, "-s") == 0)
+        {
+            if (std::sscanf(value, "%dx%d", &options->width, &options->height) != 2)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+        i += 1;
+    }
+    return 0 < options->receivers && options->receivers <= sc::FrameBuffer::NUM_RECEIVER_SLOTS &&
+           0 < options->frames && 0 < options->framerate;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    const char* role = nullptr;
+    if (!parseOptions(argc, argv, &options, &role))
+    {
+        std::printf("usage: latency_harness [-r RECEIVERS] [-n FRAMES] [-f FPS] [-s WIDTHxHEIGHT] [--json]\n");
+        std::printf("  -r RECEIVERS     the number of receiver processes (default: 1, up to %d)\n",
+                    sc::FrameBuffer::NUM_RECEIVER_SLOTS);
+        std::printf("  -n FRAMES        the number of frames to send (default: 600)\n");
+        std::printf("  -f FPS           the framerate (default: 60)\n");
+        std::printf("  -s WIDTHxHEIGHT  the size of frames (default: 1920x1080)\n");
+        std::printf("  --json           report in JSON\n");
+        return 1;
+    }
+    if (role && std::strcmp(role, "sender") == 0)
+    {
+        return runSender(options);
+    }
+    if (role && std::strcmp(role, "receiver") == 0)
+    {
+        return runReceiver(options);
+    }
+    return runHarness(argv[0], options);
+}